@@ -0,0 +1,157 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "blockCache.hpp"
+
+
+blockCache::blockCache (int32_t megabytes, int32_t bytes)
+{
+  cell_size = bytes;
+
+  max_blocks = (int32_t) (((int64_t) megabytes * 1024 * 1024) / (CACHE_BLOCK_SIZE * CACHE_BLOCK_SIZE * cell_size));
+  if (max_blocks < 1) max_blocks = 1;
+
+  head = tail = NULL;
+}
+
+
+
+blockCache::~blockCache ()
+{
+  CACHE_BLOCK *block = head;
+
+  while (block)
+    {
+      CACHE_BLOCK *next = block->next;
+
+      free (block->data);
+      free (block);
+
+      block = next;
+    }
+}
+
+
+
+//  Floor division of a cell index by the block size so that negative latitudes and longitudes work.
+
+int64_t 
+blockCache::blockIndex (int64_t cell)
+{
+  return ((cell >= 0) ? cell / CACHE_BLOCK_SIZE : -((-cell - 1) / CACHE_BLOCK_SIZE) - 1);
+}
+
+
+
+//  Move a block to the front of the LRU list.
+
+void 
+blockCache::touch (CACHE_BLOCK *block)
+{
+  if (block == head) return;
+
+
+  //  Unlink it.
+
+  if (block->prev) block->prev->next = block->next;
+  if (block->next) block->next->prev = block->prev;
+  if (block == tail) tail = block->prev;
+
+
+  //  Put it at the front.
+
+  block->prev = NULL;
+  block->next = head;
+  if (head) head->prev = block;
+  head = block;
+  if (!tail) tail = block;
+}
+
+
+
+//  Find the block for a key, allocating a new one (or recycling the least recently used one) if it isn't in the cache.  New
+//  blocks are cleared by the subclass.  This is only called with the mutex locked.
+
+CACHE_BLOCK *
+blockCache::getBlock (int64_t key)
+{
+  CACHE_BLOCK *block = blocks.value (key);
+
+  if (block)
+    {
+      touch (block);
+      return (block);
+    }
+
+
+  if (blocks.size () >= max_blocks)
+    {
+      block = tail;
+      blocks.remove (block->key);
+    }
+  else
+    {
+      block = (CACHE_BLOCK *) calloc (1, sizeof (CACHE_BLOCK));
+      block->data = (uint8_t *) malloc (CACHE_BLOCK_SIZE * CACHE_BLOCK_SIZE * cell_size);
+
+      if (block->data == NULL)
+        {
+          perror ("Allocating cache block");
+          exit (-1);
+        }
+
+
+      //  Link it in at the tail so that touch will move it to the front.
+
+      block->prev = tail;
+      block->next = NULL;
+      if (tail) tail->next = block;
+      tail = block;
+      if (!head) head = block;
+    }
+
+
+  clearBlock (block);
+
+  block->key = key;
+  blocks.insert (key, block);
+
+  touch (block);
+
+  return (block);
+}
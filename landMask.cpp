@@ -0,0 +1,480 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "landMask.hpp"
+
+
+landMask::landMask ()
+{
+  head = NULL;
+  swbd = NULL;
+  resolution = 1;
+  width = height = row_bytes = 0;
+  prev_key = -1;
+  land_fraction = 0.0;
+  cell_x0 = cell_y0 = 0;
+  cell_cols = sat_row = 0;
+  lookups = hits = 0;
+}
+
+
+
+landMask::~landMask ()
+{
+}
+
+
+
+//  Allocate the bitmap for the PFM bin grid.  The resolution is the SWBD mask resolution in arc seconds.  All SWBD reads go
+//  through the cache.  If fraction isn't 0 we set up the summed area table columns for the land fraction test.
+
+void 
+landMask::setup (BIN_HEADER *hd, int32_t res, swbdCache *cache, float fraction)
+{
+  head = hd;
+  swbd = cache;
+  resolution = res;
+  width = head->bin_width;
+  height = head->bin_height;
+  row_bytes = (width + 7) / 8;
+  prev_key = -1;
+  land_fraction = fraction;
+  lookups = hits = 0;
+
+  bits.fill (0, row_bytes * height);
+
+
+  if (land_fraction > 0.0)
+    {
+      double cells_per_degree = 3600.0 / (double) resolution;
+
+
+      //  A bin gets the cells whose centers are inside it.
+
+      cell_x0 = (int64_t) floor (head->mbr.min_x * cells_per_degree);
+      cell_y0 = (int64_t) floor (head->mbr.min_y * cells_per_degree);
+
+      col_edge.resize (width + 1);
+
+      for (int32_t j = 0 ; j <= width ; j++)
+        {
+          double lon = head->mbr.min_x + (double) j * head->x_bin_size_degrees;
+
+          col_edge[j] = (int32_t) (ceil (lon * cells_per_degree - 0.5) - cell_x0);
+        }
+
+      cell_cols = col_edge[width];
+
+      sat.fill (0, cell_cols + 1);
+      sat_low.fill (0, cell_cols + 1);
+      sat_row = 0;
+    }
+}
+
+
+
+void 
+landMask::clear ()
+{
+  bits.clear ();
+  bits.squeeze ();
+  sat.clear ();
+  sat.squeeze ();
+  sat_low.clear ();
+  sat_low.squeeze ();
+  col_edge.clear ();
+  col_edge.squeeze ();
+
+  for (int32_t level = 0 ; level < LAND_LEVELS ; level++)
+    {
+      pyramid[level].clear ();
+      pyramid[level].squeeze ();
+    }
+}
+
+
+
+//  Look up a position in the SWBD cache and count the lookup.  The cache is shared by the batch engines so we keep our own
+//  counts.
+
+uint8_t 
+landMask::swbdLand (double lat, double lon)
+{
+  uint8_t hit;
+
+  uint8_t land = swbd->isLand (lat, lon, resolution, &hit);
+
+  lookups++;
+  if (hit) hits++;
+
+  return (land);
+}
+
+
+
+//  Rasterize one row of the SWBD mask onto the bin grid.  We only ask the SWBD reader about a position when the bin center
+//  moves into a different SWBD cell.  If the whole row is in the same SWBD row as the previous one we just copy it.  This
+//  has to be called in row order.
+
+void 
+landMask::buildRow (int32_t row)
+{
+  double cells_per_degree = 3600.0 / (double) resolution;
+  double half_x = head->x_bin_size_degrees / 2.0, half_y = head->y_bin_size_degrees / 2.0;
+  double lat = head->mbr.min_y + (double) row * head->y_bin_size_degrees + half_y;
+
+  uint8_t *dst = &bits[(int64_t) row * row_bytes];
+
+
+  if (land_fraction > 0.0)
+    {
+      buildFractionRow (row, dst);
+      return;
+    }
+
+
+  int64_t key = (int64_t) floor (lat * cells_per_degree);
+
+  if (row && key == prev_key)
+    {
+      memcpy (dst, dst - row_bytes, row_bytes);
+      return;
+    }
+
+  prev_key = key;
+
+
+  int64_t prev_x = INT64_MIN;
+  uint8_t land = NVFalse;
+
+  for (int32_t j = 0 ; j < width ; j++)
+    {
+      double lon = head->mbr.min_x + (double) j * head->x_bin_size_degrees + half_x;
+
+      int64_t key_x = (int64_t) floor (lon * cells_per_degree);
+
+      if (key_x != prev_x)
+        {
+          land = swbdLand (lat, lon);
+          prev_x = key_x;
+        }
+
+      if (land) dst[j >> 3] |= (1 << (j & 7));
+    }
+}
+
+
+
+QString 
+landMask::cacheName (QString pfm_file)
+{
+  return (pfm_file + ".mask_land");
+}
+
+
+
+//  Fill in the key part of a cache header for the current grid.  The polygon is hashed (64 bit FNV-1a) instead of stored.
+
+void 
+landMask::cacheHeader (LAND_CACHE_HEADER *hdr, QString source)
+{
+  memset (hdr, 0, sizeof (LAND_CACHE_HEADER));
+  strcpy (hdr->magic, LAND_CACHE_MAGIC);
+  hdr->version = LAND_CACHE_VERSION;
+  hdr->width = width;
+  hdr->height = height;
+  hdr->resolution = resolution;
+  hdr->min_x = head->mbr.min_x;
+  hdr->min_y = head->mbr.min_y;
+  hdr->max_x = head->mbr.max_x;
+  hdr->max_y = head->mbr.max_y;
+  hdr->x_bin_size_degrees = head->x_bin_size_degrees;
+  hdr->y_bin_size_degrees = head->y_bin_size_degrees;
+  hdr->polygon_count = head->polygon_count;
+  hdr->fraction = land_fraction;
+  strncpy (hdr->source, source.toLatin1 (), sizeof (hdr->source) - 1);
+
+
+  uint64_t hash = 14695981039346656037ULL;
+  const uint8_t *ptr = (const uint8_t *) head->polygon;
+
+  for (uint32_t i = 0 ; i < head->polygon_count * sizeof (head->polygon[0]) ; i++)
+    {
+      hash ^= ptr[i];
+      hash *= 1099511628211ULL;
+    }
+
+  hdr->polygon_hash = hash;
+}
+
+
+
+//  Read the land mask from the sidecar cache.  This has to be called after setup.  Returns NVFalse (and leaves an empty bitmap)
+//  if the file doesn't exist or doesn't match the grid, polygon, or SWBD data.
+
+uint8_t 
+landMask::read (QString name, QString source)
+{
+  LAND_CACHE_HEADER key, hdr;
+  FILE              *fp;
+
+
+  if ((fp = rleBitmap::open (name, &hdr, sizeof (LAND_CACHE_HEADER))) == NULL) return (NVFalse);
+
+
+  cacheHeader (&key, source);
+  key.count = hdr.count;
+
+  if (memcmp (&hdr, &key, sizeof (LAND_CACHE_HEADER)))
+    {
+      fclose (fp);
+      return (NVFalse);
+    }
+
+
+  uint8_t ok = rleBitmap::readRows (fp, bits.data (), width, height, hdr.count);
+
+  fclose (fp);
+
+  return (ok);
+}
+
+
+
+//  Write the land mask to the sidecar cache.
+
+uint8_t 
+landMask::write (QString name, QString source)
+{
+  LAND_CACHE_HEADER hdr;
+
+
+  cacheHeader (&hdr, source);
+  hdr.count = rleBitmap::count (bits.data (), width, height);
+
+  return (rleBitmap::write (name, &hdr, sizeof (LAND_CACHE_HEADER), bits.data (), width, height));
+}
+
+
+
+//  Add SWBD cell rows to the summed area table until sat holds the sums for everything below row (relative to cell_y0).
+
+void 
+landMask::advanceTable (int32_t row)
+{
+  double cells_per_degree = 3600.0 / (double) resolution;
+
+
+  for ( ; sat_row < row ; sat_row++)
+    {
+      double lat = ((double) (cell_y0 + sat_row) + 0.5) / cells_per_degree;
+      int64_t sum = 0;
+
+      for (int32_t c = 0 ; c < cell_cols ; c++)
+        {
+          double lon = ((double) (cell_x0 + c) + 0.5) / cells_per_degree;
+
+          if (swbdLand (lat, lon)) sum++;
+
+          sat[c + 1] += sum;
+        }
+    }
+}
+
+
+
+//  Set the bits for one row using the land fraction of each bin.  The number of land cells in a bin is the usual four corner
+//  summed area table lookup using the table rows for the bottom and top edges of the bin row.  If a bin is smaller than a
+//  cell (it has no cell centers in it) we fall back to the cell at the bin center.  This has to be called in row order.
+
+void 
+landMask::buildFractionRow (int32_t row, uint8_t *dst)
+{
+  double cells_per_degree = 3600.0 / (double) resolution;
+  double lat0 = head->mbr.min_y + (double) row * head->y_bin_size_degrees;
+  double lat1 = head->mbr.min_y + (double) (row + 1) * head->y_bin_size_degrees;
+
+  int32_t r0 = (int32_t) (ceil (lat0 * cells_per_degree - 0.5) - cell_y0);
+  int32_t r1 = (int32_t) (ceil (lat1 * cells_per_degree - 0.5) - cell_y0);
+
+
+  advanceTable (r0);
+  sat_low = sat;
+  advanceTable (r1);
+
+
+  for (int32_t j = 0 ; j < width ; j++)
+    {
+      int32_t c0 = col_edge[j], c1 = col_edge[j + 1];
+      uint8_t land;
+
+      if (r1 > r0 && c1 > c0)
+        {
+          int64_t count = sat[c1] - sat[c0] - sat_low[c1] + sat_low[c0];
+
+          land = ((double) count >= (double) land_fraction * (double) ((int64_t) (r1 - r0) * (c1 - c0)));
+        }
+      else
+        {
+          land = swbdLand ((lat0 + lat1) / 2.0, head->mbr.min_x + ((double) j + 0.5) * head->x_bin_size_degrees);
+        }
+
+      if (land) dst[j >> 3] |= (1 << (j & 7));
+    }
+}
+
+
+
+//  Figure out if a span of bits in a row is all water, all land, or mixed.  The first column must be on a byte boundary.
+
+uint8_t 
+landMask::rowState (int32_t row, int32_t col0, int32_t col1)
+{
+  uint8_t *src = &bits[row * row_bytes];
+  uint8_t water = NVFalse, land = NVFalse;
+
+
+  for (int32_t col = col0 ; col < col1 ; col += 8)
+    {
+      int32_t count = qMin (8, col1 - col);
+      uint8_t mask = (count == 8) ? 0xff : (uint8_t) ((1 << count) - 1);
+      uint8_t byte = src[col >> 3] & mask;
+
+      if (byte) land = NVTrue;
+      if (byte != mask) water = NVTrue;
+
+      if (land && water) return (LAND_MIXED);
+    }
+
+  return (land ? LAND_ALL : LAND_NONE);
+}
+
+
+
+//  Build the all water/all land/mixed pyramid from the bitmap.  The finest level is built from the bits and each coarser
+//  level is built from the level below it.
+
+void 
+landMask::buildPyramid ()
+{
+  int32_t size = LAND_BLOCK_SIZE, blocks_high[LAND_LEVELS];
+
+
+  for (int32_t level = 0 ; level < LAND_LEVELS ; level++)
+    {
+      blocks_wide[level] = (width + size - 1) / size;
+      blocks_high[level] = (height + size - 1) / size;
+
+      pyramid[level].fill (LAND_NONE, blocks_wide[level] * blocks_high[level]);
+
+      size *= LAND_BLOCK_FACTOR;
+    }
+
+
+  for (int32_t by = 0 ; by < blocks_high[0] ; by++)
+    {
+      int32_t row1 = qMin ((by + 1) * LAND_BLOCK_SIZE, height);
+
+      for (int32_t bx = 0 ; bx < blocks_wide[0] ; bx++)
+        {
+          int32_t col0 = bx * LAND_BLOCK_SIZE, col1 = qMin (col0 + LAND_BLOCK_SIZE, width);
+
+          uint8_t state = rowState (by * LAND_BLOCK_SIZE, col0, col1);
+
+          for (int32_t row = by * LAND_BLOCK_SIZE + 1 ; row < row1 && state != LAND_MIXED ; row++)
+            {
+              if (rowState (row, col0, col1) != state) state = LAND_MIXED;
+            }
+
+          pyramid[0][by * blocks_wide[0] + bx] = state;
+        }
+    }
+
+
+  for (int32_t level = 1 ; level < LAND_LEVELS ; level++)
+    {
+      for (int32_t by = 0 ; by < blocks_high[level] ; by++)
+        {
+          for (int32_t bx = 0 ; bx < blocks_wide[level] ; bx++)
+            {
+              int32_t y0 = by * LAND_BLOCK_FACTOR, y1 = qMin (y0 + LAND_BLOCK_FACTOR, blocks_high[level - 1]);
+              int32_t x0 = bx * LAND_BLOCK_FACTOR, x1 = qMin (x0 + LAND_BLOCK_FACTOR, blocks_wide[level - 1]);
+
+              uint8_t state = pyramid[level - 1][y0 * blocks_wide[level - 1] + x0];
+
+              for (int32_t y = y0 ; y < y1 && state != LAND_MIXED ; y++)
+                {
+                  for (int32_t x = x0 ; x < x1 ; x++)
+                    {
+                      if (pyramid[level - 1][y * blocks_wide[level - 1] + x] != state)
+                        {
+                          state = LAND_MIXED;
+                          break;
+                        }
+                    }
+                }
+
+              pyramid[level][by * blocks_wide[level] + bx] = state;
+            }
+        }
+    }
+}
+
+
+
+//  If the bin at row, col is in a block (at the coarsest level possible) that is entirely the requested state return the
+//  number of bins from col to the end of the block in that row.  Otherwise return 0.
+
+int32_t 
+landMask::run (int32_t row, int32_t col, uint8_t state)
+{
+  int32_t size = LAND_BLOCK_SIZE;
+
+  for (int32_t level = 1 ; level < LAND_LEVELS ; level++) size *= LAND_BLOCK_FACTOR;
+
+
+  for (int32_t level = LAND_LEVELS - 1 ; level >= 0 ; level--)
+    {
+      if (pyramid[level][(row / size) * blocks_wide[level] + col / size] == state)
+        return (qMin ((col / size + 1) * size, width) - col);
+
+      size /= LAND_BLOCK_FACTOR;
+    }
+
+  return (0);
+}
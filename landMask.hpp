@@ -0,0 +1,177 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef LANDMASK_H
+#define LANDMASK_H
+
+#include "pfmMaskDef.hpp"
+#include "swbdCache.hpp"
+#include "rleBitmap.hpp"
+
+
+#define         LAND_NONE           0           //  All water block
+#define         LAND_ALL            1           //  All land block
+#define         LAND_MIXED          2           //  Mixed land and water block
+
+#define         LAND_LEVELS         3           //  Number of levels in the land mask pyramid
+#define         LAND_BLOCK_SIZE     16          //  Bins per side of the finest pyramid blocks (must be a multiple of 8)
+#define         LAND_BLOCK_FACTOR   8           //  Each pyramid level is this many times coarser than the one below
+
+#define         LAND_CACHE_MAGIC    "pfmMask land"
+#define         LAND_CACHE_VERSION  1
+
+
+//  Header of the land mask sidecar cache (PFM_FILE.mask_land).  Everything but the count is the key.
+
+typedef struct
+{
+  char          magic[16];
+  int32_t       version;
+  int32_t       width;
+  int32_t       height;
+  int32_t       resolution;                 //  SWBD mask resolution in arc seconds
+  double        min_x;
+  double        min_y;
+  double        max_x;
+  double        max_y;
+  double        x_bin_size_degrees;
+  double        y_bin_size_degrees;
+  int32_t       polygon_count;
+  uint64_t      polygon_hash;
+  float         fraction;                   //  Land fraction threshold (0 for the bin center)
+  char          source[256];                //  SWBD data version (see swbdCache::version)
+  int64_t       count;                      //  Number of land bins
+} LAND_CACHE_HEADER;
+
+
+/*!
+    Land mask rasterized onto the PFM bin grid.  The SWBD mask is evaluated once per bin (in one pass, before the masking
+    loop) and stored as one bit per bin so that the masking loop only has to test bits.  Rows are padded to a byte
+    boundary so that a row can be copied when consecutive bin rows fall in the same SWBD row.
+
+    After the bitmap is built a pyramid of 16, 128, and 1024 bin blocks flagged as all water, all land, or mixed is
+    built from it so that the masking loop can skip or bulk fill whole blocks.
+
+    If a land fraction is set, a bin is land when at least that fraction of the SWBD cells (with centers) in the bin are
+    land instead of when the bin center is land.  The fractions come from a summed area table of the SWBD cells covering
+    the PFM that is built a cell row at a time as we work up the bin rows, so we only ever hold two rows of it.
+
+    Since we mask the same areas over and over, the bitmap is saved next to the PFM list file (PFM_FILE.mask_land), run
+    length encoded by row like the mask index (see rleBitmap).  If the grid geometry, polygon, resolution, land fraction,
+    and SWBD mask files all match, the next run reads it instead of going back to the SWBD.
+*/
+
+class landMask
+{
+public:
+
+  landMask ();
+  ~landMask ();
+
+  void setup (BIN_HEADER *head, int32_t res, swbdCache *cache, float fraction = 0.0);
+  void buildRow (int32_t row);
+  void buildPyramid ();
+  int32_t run (int32_t row, int32_t col, uint8_t state);
+  void clear ();
+  uint8_t read (QString name, QString source);
+  uint8_t write (QString name, QString source);
+
+  static QString cacheName (QString pfm_file);
+
+
+  int64_t          lookups;                 //  SWBD cache lookups made building this mask
+
+  int64_t          hits;                    //  The ones that were already in the cache
+
+
+  //  Test the bit for a bin.
+
+  inline uint8_t isLand (int32_t row, int32_t col)
+  {
+    return ((bits[(int64_t) row * row_bytes + (col >> 3)] >> (col & 7)) & 1);
+  }
+
+
+protected:
+
+  BIN_HEADER       *head;
+
+  swbdCache        *swbd;
+
+  int32_t          resolution;
+
+  int32_t          width;
+
+  int32_t          height;
+
+  int32_t          row_bytes;
+
+  int64_t          prev_key;                //  SWBD row of the previous bin row
+
+  QVector<uint8_t> bits;
+
+  int32_t          blocks_wide[LAND_LEVELS];
+
+  QVector<uint8_t> pyramid[LAND_LEVELS];
+
+
+  float            land_fraction;           //  Minimum land fraction for a land bin (0 to use the bin center)
+
+  int64_t          cell_x0;                 //  SWBD column of the first summed area table column
+
+  int64_t          cell_y0;                 //  SWBD row of the first summed area table row
+
+  int32_t          cell_cols;
+
+  int32_t          sat_row;                 //  Summed area table row in sat (relative to cell_y0)
+
+  QVector<int64_t> sat;                     //  Land cells below sat_row, left of each column
+
+  QVector<int64_t> sat_low;                 //  The same for the bottom edge of the current bin row
+
+  QVector<int32_t> col_edge;                //  First summed area table column in each bin (and one past the last bin)
+
+
+  uint8_t swbdLand (double lat, double lon);
+  uint8_t rowState (int32_t row, int32_t col0, int32_t col1);
+  void cacheHeader (LAND_CACHE_HEADER *hdr, QString source);
+  void advanceTable (int32_t row);
+  void buildFractionRow (int32_t row, uint8_t *dst);
+};
+
+#endif
@@ -50,11 +50,603 @@
 \***************************************************************************/
 
 #include "pfmMask.hpp"
+#include "maskBatch.hpp"
+#include "maskBench.hpp"
 #include "version.hpp"
 
+#include <getopt.h>
+
+
+void usage ()
+{
+  fprintf (stderr, "\n%s\n\n", VERSION);
+  fprintf (stderr, "Usage: pfmMask [PFM_FILE]\n");
+  fprintf (stderr, "       pfmMask --batch PFM_FILE [PFM_FILE ...] [--list FILE] [--jobs N] [--mask VALUE] [--topo] [--nodecon]\n");
+  fprintf (stderr, "                      [--threads N] [--cache MB] [--dry-run] [--journal] [--resume] [--stage MB]\n");
+  fprintf (stderr, "                      [--land-res SECONDS] [--land-fraction FRACTION]\n");
+  fprintf (stderr, "       pfmMask --batch PFM_FILE [PFM_FILE ...] --rollback\n");
+  fprintf (stderr, "       pfmMask --benchmark [--bench-size WIDTHxHEIGHT] [--bench-land FRACTION] [--bench-polygon SHAPE]\n");
+  fprintf (stderr, "                          [--bench-points N] [--bench-misp] [--bench-path PATH] [--threads N] [--topo]\n");
+  fprintf (stderr, "                          [--stage MB] [--verify]\n\n");
+  fprintf (stderr, "Where:\n\n");
+  fprintf (stderr, "\tPFM_FILE = PFM list file to be masked\n");
+  fprintf (stderr, "\t--batch = run without the GUI (no display needed)\n");
+  fprintf (stderr, "\t--list = file containing PFM file names (or wildcard patterns), one per line\n");
+  fprintf (stderr, "\t--jobs = number of PFM files to mask at the same time (default 1)\n");
+  fprintf (stderr, "\t--mask = value to be stored in empty land bins (default -5.0)\n");
+  fprintf (stderr, "\t--topo = use SRTM topo data instead of the fixed mask value\n");
+  fprintf (stderr, "\t--nodecon = don't deconflict SRTM data that is already loaded in the PFM\n");
+  fprintf (stderr, "\t--threads = number of worker threads per job (default is the number of cores divided by --jobs)\n");
+  fprintf (stderr, "\t--cache = SRTM topo cache size in megabytes (default %d)\n", SRTM_CACHE_SIZE);
+  fprintf (stderr, "\t--dry-run = report what would be done without checkpointing or modifying the PFM\n");
+  fprintf (stderr, "\t--journal = save the changed records in an undo journal (PFM_FILE.mask_journal) instead of\n");
+  fprintf (stderr, "\t            checkpointing the whole PFM\n");
+  fprintf (stderr, "\t--rollback = undo all journaled runs on PFM_FILE\n");
+  fprintf (stderr, "\t--resume = pick up an interrupted run where it left off (using the original run's mask settings)\n");
+  fprintf (stderr, "\t--stage = do the masking in memory (up to MB megabytes) and write the changes back in one pass\n");
+  fprintf (stderr, "\t--land-res = SWBD land mask resolution, 1, 3, 30, or 60 arc seconds (default is the coarsest mask\n");
+  fprintf (stderr, "\t             that isn't coarser than the PFM bins)\n");
+  fprintf (stderr, "\t--land-fraction = mask bins that are at least this fraction land in the SWBD mask instead of bins\n");
+  fprintf (stderr, "\t                  whose centers are land (default 0, use the center)\n");
+  fprintf (stderr, "\t--benchmark = time the masking engine on a synthetic in memory PFM (no data files needed)\n");
+  fprintf (stderr, "\t--bench-size = synthetic grid size in bins (default 2000x2000)\n");
+  fprintf (stderr, "\t--bench-land = fraction of the synthetic grid that is land (default 0.4)\n");
+  fprintf (stderr, "\t--bench-polygon = rectangle, diamond, circle, concave, or random (default rectangle)\n");
+  fprintf (stderr, "\t--bench-points = depth records in each synthetic survey bin (default 4)\n");
+  fprintf (stderr, "\t--bench-misp = give the synthetic PFM a MISP average surface\n");
+  fprintf (stderr, "\t--bench-path = fresh, remask, decon, or all (default all)\n");
+  fprintf (stderr, "\t--verify = check the benchmark results (the polygon classification of every bin for every polygon\n");
+  fprintf (stderr, "\t           shape and the contents of the synthetic PFM after each run) as well as timing them.  With\n");
+  fprintf (stderr, "\t           --bench-misp the bin records are also compared with a run that re-reads, writes, and\n");
+  fprintf (stderr, "\t           recomputes the MISP bins the old way\n\n");
+  fflush (stderr);
+}
+
+
+
+//  Print the dry run report.  The byte counts are estimates based on the unpacked record sizes (the PFM library bit packs the
+//  records so the real numbers will be smaller).
+
+void dryRunReport (MASK_SUMMARY *sum)
+{
+  int64_t adds = sum->fill;
+  int64_t changes = sum->remask + sum->decon_records;
+  int64_t bins = sum->fill + sum->remask + sum->decon;
+
+  printf ("Bins inside polygon               : %" PRId64 "\n", sum->inside);
+  printf ("Land bins                         : %" PRId64 "\n", sum->land);
+  printf ("Empty bins to be masked           : %" PRId64 "\n", sum->fill);
+  printf ("Bins to be re-masked              : %" PRId64 "\n", sum->remask);
+  printf ("Bins to be deconflicted           : %" PRId64 "\n", sum->decon);
+  printf ("SRTM records to be invalidated    : %" PRId64 "\n", sum->decon_records);
+  printf ("Estimated depth records added     : %" PRId64 "\n", adds);
+  printf ("Estimated depth records changed   : %" PRId64 "\n", changes);
+  printf ("Estimated bin records written     : %" PRId64 "\n", bins);
+  printf ("Estimated bytes written           : %" PRId64 "\n", (adds + changes) * (int64_t) sizeof (DEPTH_RECORD) +
+          bins * (int64_t) sizeof (BIN_RECORD));
+  fflush (stdout);
+}
+
+
+
+//  Add a file name to the list, expanding wildcards (the shell expands them on the command line but not in --list files).
+
+void addFiles (QStringList *files, QString pattern)
+{
+  pattern = pattern.trimmed ();
+
+  if (pattern.isEmpty ()) return;
+
+  if (!pattern.contains ('*') && !pattern.contains ('?') && !pattern.contains ('['))
+    {
+      files->append (pattern);
+      return;
+    }
+
+
+  QFileInfo info (pattern);
+  QDir dir (info.path ());
+
+  QStringList names = dir.entryList (QStringList (info.fileName ()), QDir::Files, QDir::Name);
+
+  for (int32_t i = 0 ; i < names.size () ; i++) files->append (dir.filePath (names[i]));
+}
+
+
+
+//  Print the per file results of a multiple file batch run.
+
+void batchReport (maskBatch *bat, uint8_t dry_run)
+{
+  int32_t failed = 0;
+
+
+  printf ("\n%-50s %8s %10s %12s %12s %12s\n", "PFM file", "Status", "Seconds", "Masked", "Re-masked", "Deconflicted");
+
+  for (int32_t i = 0 ; i < bat->results.size () ; i++)
+    {
+      MASK_JOB *res = &bat->results[i];
+
+      printf ("%-50s %8s %10.1f %12" PRId64 " %12" PRId64 " %12" PRId64 "\n", res->pfm_file.toLatin1 ().constData (),
+              res->status ? "FAILED" : "OK", res->seconds, res->summary.fill, res->summary.remask, res->summary.decon);
+
+      if (res->status) failed++;
+    }
+
+  printf ("\n%d of %d files failed\n", failed, bat->results.size ());
+
+  if (!dry_run) printf ("Phase timers and counters for each file are in PFM_FILE%s\n",
+                        maskEngine::reportName ("").toLatin1 ().constData ());
+
+
+  for (int32_t i = 0 ; i < bat->results.size () ; i++)
+    {
+      MASK_JOB *res = &bat->results[i];
+
+      if (res->status)
+        {
+          printf ("\n%s : %s\n", res->pfm_file.toLatin1 ().constData (), res->error.toLatin1 ().constData ());
+        }
+      else if (dry_run)
+        {
+          printf ("\n%s\n\n", res->pfm_file.toLatin1 ().constData ());
+          dryRunReport (&res->summary);
+        }
+    }
+
+  fflush (stdout);
+}
+
+
+
+//  Batch (headless) mode.  We only need a core application here since we never open a display.
+
+int32_t batch (int argc, char **argv)
+{
+  MASK_PARAMS       params;
+  int32_t           option_index = 0;
+  uint8_t           rollback = NVFalse;
+  int32_t           jobs = 1;
+  uint8_t           threads_set = NVFalse;
+  QStringList       files;
+  uint8_t           benchmark = NVFalse;
+  MASK_BENCH        bench;
+
+
+  QCoreApplication a (argc, argv);
+
+
+  params.topo = NVFalse;
+  params.mask = -5.0;
+  params.deconflict = NVTrue;
+  params.verbose = NVTrue;
+  params.threads = QThread::idealThreadCount ();
+  params.cache_size = SRTM_CACHE_SIZE;
+  params.dry_run = NVFalse;
+  params.journal = NVFalse;
+  params.resume = NVFalse;
+  params.stage_size = 0;
+  params.land_resolution = 0;
+  params.land_fraction = 0.0;
+
+  bench.width = 2000;
+  bench.height = 2000;
+  bench.land = 0.4;
+  bench.polygon = BENCH_RECTANGLE;
+  bench.points = 4;
+  bench.misp = NVFalse;
+  bench.path = BENCH_PATHS;
+  bench.snap = NVFalse;
+  bench.verify = NVFalse;
+
+
+  while (NVTrue) 
+    {
+      static struct option long_options[] = {{"batch", required_argument, 0, 0},
+                                             {"mask", required_argument, 0, 0},
+                                             {"topo", no_argument, 0, 0},
+                                             {"nodecon", no_argument, 0, 0},
+                                             {"threads", required_argument, 0, 0},
+                                             {"cache", required_argument, 0, 0},
+                                             {"dry-run", no_argument, 0, 0},
+                                             {"journal", no_argument, 0, 0},
+                                             {"rollback", no_argument, 0, 0},
+                                             {"resume", no_argument, 0, 0},
+                                             {"jobs", required_argument, 0, 0},
+                                             {"list", required_argument, 0, 0},
+                                             {"benchmark", no_argument, 0, 0},
+                                             {"bench-size", required_argument, 0, 0},
+                                             {"bench-land", required_argument, 0, 0},
+                                             {"bench-polygon", required_argument, 0, 0},
+                                             {"bench-points", required_argument, 0, 0},
+                                             {"bench-misp", no_argument, 0, 0},
+                                             {"bench-path", required_argument, 0, 0},
+                                             {"stage", required_argument, 0, 0},
+                                             {"land-res", required_argument, 0, 0},
+                                             {"land-fraction", required_argument, 0, 0},
+                                             {"verify", no_argument, 0, 0},
+                                             {0, no_argument, 0, 0}};
+
+      int c = getopt_long (argc, argv, "", long_options, &option_index);
+      if (c == -1) break;
+
+      switch (c) 
+        {
+        case 0:
+
+          switch (option_index)
+            {
+            case 0:
+              addFiles (&files, QString (optarg));
+              break;
+
+            case 1:
+              if (sscanf (optarg, "%f", &params.mask) != 1)
+                {
+                  fprintf (stderr, "\nInvalid --mask value %s, it must be a number\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 2:
+              params.topo = NVTrue;
+              break;
+
+            case 3:
+              params.deconflict = NVFalse;
+              break;
+
+            case 4:
+              if (sscanf (optarg, "%d", &params.threads) != 1 || params.threads < 1)
+                {
+                  fprintf (stderr, "\nInvalid --threads value %s, it must be at least 1\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              threads_set = NVTrue;
+              break;
+
+            case 5:
+              if (sscanf (optarg, "%d", &params.cache_size) != 1 || params.cache_size < 1)
+                {
+                  fprintf (stderr, "\nInvalid --cache value %s, it must be at least 1 megabyte\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 6:
+              params.dry_run = NVTrue;
+              break;
+
+            case 7:
+              params.journal = NVTrue;
+              break;
+
+            case 8:
+              rollback = NVTrue;
+              break;
+
+            case 9:
+              params.resume = NVTrue;
+              break;
+
+            case 10:
+              if (sscanf (optarg, "%d", &jobs) != 1 || jobs < 1)
+                {
+                  fprintf (stderr, "\nInvalid --jobs value %s, it must be at least 1\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 11:
+              {
+                FILE *fp;
+                char string[1024];
+
+                if ((fp = fopen (optarg, "r")) == NULL)
+                  {
+                    perror (optarg);
+                    exit (-1);
+                  }
+
+                while (fgets (string, sizeof (string), fp)) addFiles (&files, QString (string));
+
+                fclose (fp);
+              }
+              break;
+
+            case 12:
+              benchmark = NVTrue;
+              break;
+
+            case 13:
+              if (sscanf (optarg, "%dx%d", &bench.width, &bench.height) != 2 || bench.width < 1 || bench.height < 1)
+                {
+                  fprintf (stderr, "\nInvalid --bench-size value %s, it must be WIDTHxHEIGHT with both at least 1\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 14:
+              if (sscanf (optarg, "%f", &bench.land) != 1 || !(bench.land >= 0.0 && bench.land <= 1.0))
+                {
+                  fprintf (stderr, "\nInvalid --bench-land value %s, it must be between 0 and 1\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 15:
+              if (!strcmp (optarg, "rectangle"))
+                {
+                  bench.polygon = BENCH_RECTANGLE;
+                }
+              else if (!strcmp (optarg, "diamond"))
+                {
+                  bench.polygon = BENCH_DIAMOND;
+                }
+              else if (!strcmp (optarg, "circle"))
+                {
+                  bench.polygon = BENCH_CIRCLE;
+                }
+              else if (!strcmp (optarg, "concave"))
+                {
+                  bench.polygon = BENCH_CONCAVE;
+                }
+              else if (!strcmp (optarg, "random"))
+                {
+                  bench.polygon = BENCH_RANDOM;
+                }
+              else
+                {
+                  fprintf (stderr, "\nInvalid --bench-polygon value %s, it must be rectangle, diamond, circle, concave, or random\n",
+                           optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 16:
+              if (sscanf (optarg, "%d", &bench.points) != 1 || bench.points < 1)
+                {
+                  fprintf (stderr, "\nInvalid --bench-points value %s, it must be at least 1\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 17:
+              bench.misp = NVTrue;
+              break;
+
+            case 18:
+              if (!strcmp (optarg, "fresh"))
+                {
+                  bench.path = BENCH_FRESH;
+                }
+              else if (!strcmp (optarg, "remask"))
+                {
+                  bench.path = BENCH_REMASK;
+                }
+              else if (!strcmp (optarg, "decon"))
+                {
+                  bench.path = BENCH_DECON;
+                }
+              else if (!strcmp (optarg, "all"))
+                {
+                  bench.path = BENCH_PATHS;
+                }
+              else
+                {
+                  fprintf (stderr, "\nInvalid --bench-path value %s, it must be fresh, remask, decon, or all\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 19:
+              if (sscanf (optarg, "%d", &params.stage_size) != 1 || params.stage_size < 1)
+                {
+                  fprintf (stderr, "\nInvalid --stage value %s, it must be at least 1 megabyte\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 20:
+              if (sscanf (optarg, "%d", &params.land_resolution) != 1 || (params.land_resolution != 1 &&
+                  params.land_resolution != 3 && params.land_resolution != 30 && params.land_resolution != 60))
+                {
+                  fprintf (stderr, "\nInvalid --land-res value %s, it must be 1, 3, 30, or 60\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 21:
+              if (sscanf (optarg, "%f", &params.land_fraction) != 1 || !(params.land_fraction >= 0.0 && params.land_fraction <= 1.0))
+                {
+                  fprintf (stderr, "\nInvalid --land-fraction value %s, it must be between 0 and 1\n", optarg);
+                  usage ();
+                  exit (-1);
+                }
+              break;
+
+            case 22:
+              bench.verify = NVTrue;
+              break;
+            }
+          break;
+
+        default:
+          usage ();
+          exit (-1);
+          break;
+        }
+    }
+
+
+  if (benchmark)
+    {
+      fprintf (stderr, "\n%s\n\n", VERSION);
+      fflush (stderr);
+
+      maskBench bnch (&params, &bench);
+
+      int32_t failed = bench.verify ? bnch.verify () : 0;
+
+      bnch.run ();
+      bnch.report ();
+
+      if (failed) return (-1);
+
+      for (int32_t i = 0 ; i < bnch.results.size () ; i++) if (bnch.results[i].status || bnch.results[i].errors) return (-1);
+
+      return (0);
+    }
+
+
+  //  Any other arguments are more PFM files.
+
+  for (int32_t i = optind ; i < argc ; i++) addFiles (&files, QString (argv[i]));
+
+
+  if (files.isEmpty ())
+    {
+      usage ();
+      exit (-1);
+    }
+
+  params.pfm_file = files[0];
+
+
+  if (rollback)
+    {
+      int32_t status = 0;
+
+      fprintf (stderr, "\n%s\n\n", VERSION);
+
+      for (int32_t i = 0 ; i < files.size () ; i++)
+        {
+          params.pfm_file = files[i];
+
+          fprintf (stderr, "Rolling back %s\n\n", params.pfm_file.toLatin1 ().constData ());
+          fflush (stderr);
+
+          maskEngine engine (&params);
+
+          if (engine.rollback ())
+            {
+              fprintf (stderr, "\n%s\n\n", engine.errorString ().toLatin1 ().constData ());
+              fflush (stderr);
+              status = -1;
+              continue;
+            }
+
+          fprintf (stderr, "Rollback complete\n\n");
+          fflush (stderr);
+        }
+
+      return (status);
+    }
+
+
+  if (params.topo && !check_srtm3_topo ())
+    {
+      fprintf (stderr, "\nSRTM topo data is not available.  Check your ABE_DATA environment variable.\n\n");
+      exit (-1);
+    }
+
+
+  //  More than one file goes to the batch scheduler.  Unless we were told otherwise, split the cores between the jobs.
+
+  if (files.size () > 1)
+    {
+      jobs = qMin (jobs, files.size ());
+
+      if (!threads_set) params.threads = qMax (1, QThread::idealThreadCount () / jobs);
+
+
+      fprintf (stderr, "\n%s\n\n", VERSION);
+      fprintf (stderr, "%s %d files, %d at a time\n\n", params.dry_run ? "Planning" : "Masking", files.size (), jobs);
+      fflush (stderr);
+
+
+      maskBatch bat (&params, jobs);
+
+      bat.run (files);
+
+      batchReport (&bat, params.dry_run);
+
+      for (int32_t i = 0 ; i < bat.results.size () ; i++) if (bat.results[i].status) return (-1);
+
+      return (0);
+    }
+
+
+  fprintf (stderr, "\n%s\n\n", VERSION);
+  if (params.dry_run)
+    {
+      fprintf (stderr, "Planning %s (dry run)\n\n", params.pfm_file.toLatin1 ().constData ());
+    }
+  else
+    {
+      fprintf (stderr, "Masking %s\n\n", params.pfm_file.toLatin1 ().constData ());
+    }
+  fflush (stderr);
+
+
+  maskEngine engine (&params);
+
+  if (engine.run ())
+    {
+      fprintf (stderr, "\n%s\n\n", engine.errorString ().toLatin1 ().constData ());
+      fflush (stderr);
+      return (-1);
+    }
+
+
+  if (params.dry_run)
+    {
+      MASK_SUMMARY sum = engine.summary ();
+
+      dryRunReport (&sum);
+
+      fprintf (stderr, "\nDry run complete, nothing was written\n\n");
+      fflush (stderr);
+
+      return (0);
+    }
+
+
+  fprintf (stderr, "Masking complete, run report written to %s\n\n",
+           maskEngine::reportName (params.pfm_file).toLatin1 ().constData ());
+  fflush (stderr);
+
+  return (0);
+}
+
+
 
 int main (int argc, char **argv)
 {
+    //  Check for batch mode before we try to open a display.
+
+    for (int32_t i = 1 ; i < argc ; i++)
+      {
+        if (!strcmp (argv[i], "--batch") || !strcmp (argv[i], "--benchmark")) return (batch (argc, argv));
+        if (!strcmp (argv[i], "--help") || !strcmp (argv[i], "-h"))
+          {
+            usage ();
+            return (0);
+          }
+      }
+
+
     QApplication a (argc, argv);
 
 
@@ -0,0 +1,149 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#include "maskBatch.hpp"
+
+
+maskBatch::maskBatch (MASK_PARAMS *par, int32_t jobs)
+{
+  params = *par;
+  max_jobs = jobs;
+  if (max_jobs < 1) max_jobs = 1;
+
+
+  //  The caches are filled lazily so it doesn't cost us anything to make both of them.
+
+  srtm = new srtmCache (params.cache_size);
+  swbd = new swbdCache;
+}
+
+
+
+maskBatch::~maskBatch ()
+{
+  delete srtm;
+  delete swbd;
+}
+
+
+
+//  Mask all of the files, max_jobs at a time.  This returns when all of them are done.
+
+void 
+maskBatch::run (QStringList files)
+{
+  results.resize (files.size ());
+
+  for (int32_t i = 0 ; i < files.size () ; i++)
+    {
+      results[i].pfm_file = files[i];
+      results[i].status = -1;
+      results[i].seconds = 0.0;
+      memset (&results[i].summary, 0, sizeof (MASK_SUMMARY));
+    }
+
+
+  QThreadPool pool;
+  pool.setMaxThreadCount (max_jobs);
+
+  for (int32_t i = 0 ; i < files.size () ; i++) pool.start (new maskJob (this, i));
+
+  pool.waitForDone ();
+}
+
+
+
+//  Mask one file.  The engine's percent complete output would be unreadable with more than one job running so we just report
+//  when each file starts and finishes.
+
+void 
+maskBatch::runJob (int32_t job)
+{
+  MASK_PARAMS par = params;
+  MASK_JOB *res = &results[job];
+
+
+  par.pfm_file = res->pfm_file;
+  par.verbose = NVFalse;
+
+
+  mutex.lock ();
+  fprintf (stderr, "Started %s\n", res->pfm_file.toLatin1 ().constData ());
+  fflush (stderr);
+  mutex.unlock ();
+
+
+  QElapsedTimer job_timer;
+  job_timer.start ();
+
+  maskEngine engine (&par);
+  engine.setCaches (srtm, swbd);
+
+  res->status = engine.run ();
+  res->error = engine.errorString ();
+  res->summary = engine.summary ();
+  res->seconds = (double) job_timer.elapsed () / 1000.0;
+
+
+  mutex.lock ();
+  if (res->status)
+    {
+      fprintf (stderr, "Failed %s : %s\n", res->pfm_file.toLatin1 ().constData (), res->error.toLatin1 ().constData ());
+    }
+  else
+    {
+      fprintf (stderr, "Finished %s (%.1f seconds)\n", res->pfm_file.toLatin1 ().constData (), res->seconds);
+    }
+  fflush (stderr);
+  mutex.unlock ();
+}
+
+
+
+maskJob::maskJob (maskBatch *bat, int32_t jb)
+{
+  batch = bat;
+  job = jb;
+}
+
+
+
+void 
+maskJob::run ()
+{
+  batch->runJob (job);
+}
@@ -0,0 +1,110 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#ifndef MASKBATCH_H
+#define MASKBATCH_H
+
+#include "maskEngine.hpp"
+
+
+//  Result of masking one PFM in batch mode.
+
+typedef struct
+{
+  QString       pfm_file;
+  int32_t       status;                     //  0 if the run succeeded
+  QString       error;
+  double        seconds;                    //  Wall time for the run
+  MASK_SUMMARY  summary;
+} MASK_JOB;
+
+
+/*!
+    Batch scheduler for masking a list of PFM files.  Up to jobs files are masked at the same time, each by its own masking
+    engine.  All of the engines share one SRTM topo cache and one SWBD land mask cache so that adjacent PFMs don't read the
+    same cells again.  Since the PFM library isn't thread safe the engines take turns in the library (see maskEngine) but the
+    classification, land mask, and SRTM work of one engine overlaps with the PFM I/O of the others.
+*/
+
+class maskBatch
+{
+public:
+
+  maskBatch (MASK_PARAMS *par, int32_t jobs);
+  ~maskBatch ();
+
+  void run (QStringList files);
+  void runJob (int32_t job);
+
+
+  QVector<MASK_JOB> results;
+
+
+protected:
+
+  MASK_PARAMS      params;
+
+  int32_t          max_jobs;
+
+  srtmCache        *srtm;
+
+  swbdCache        *swbd;
+
+  QMutex           mutex;                   //  Keeps the status messages from getting mixed up
+};
+
+
+
+//  One PFM file's job for the thread pool.
+
+class maskJob : public QRunnable
+{
+public:
+
+  maskJob (maskBatch *bat, int32_t jb);
+
+  void run ();
+
+
+protected:
+
+  maskBatch        *batch;
+
+  int32_t          job;
+};
+
+#endif
@@ -0,0 +1,1031 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#include "maskBench.hpp"
+
+
+#define         BENCH_MIN_X         -76.0       //  Southwest corner of the synthetic PFM
+#define         BENCH_MIN_Y         36.0
+
+
+//  Land or water for the synthetic PFM.  Land is on the west side with a wavy coastline.
+
+uint8_t 
+synthStorage::isLand (MASK_BENCH *bench, double lat, double lon)
+{
+  double fx = (lon - BENCH_MIN_X) / ((double) bench->width * BENCH_BIN_SIZE);
+  double fy = (lat - BENCH_MIN_Y) / ((double) bench->height * BENCH_BIN_SIZE);
+
+  if (bench->land <= 0.0) return (NVFalse);
+  if (bench->land >= 1.0) return (NVTrue);
+
+  return (fx < bench->land + 0.05 * sin (fy * 16.0 * M_PI));
+}
+
+
+
+//  Build the bin header for the synthetic PFM.  This is also used by the classification check (see maskBench::verify).
+
+void 
+synthStorage::makeHeader (MASK_BENCH *bnch, BIN_HEADER *hd)
+{
+  MASK_BENCH bench = *bnch;
+  BIN_HEADER &head = *hd;
+
+
+  memset (&head, 0, sizeof (BIN_HEADER));
+
+  head.bin_width = bench.width;
+  head.bin_height = bench.height;
+  head.x_bin_size_degrees = BENCH_BIN_SIZE;
+  head.y_bin_size_degrees = BENCH_BIN_SIZE;
+  head.mbr.min_x = BENCH_MIN_X;
+  head.mbr.min_y = BENCH_MIN_Y;
+  head.mbr.max_x = BENCH_MIN_X + (double) bench.width * BENCH_BIN_SIZE;
+  head.mbr.max_y = BENCH_MIN_Y + (double) bench.height * BENCH_BIN_SIZE;
+
+
+  //  The polygon vertices are half a bin inside the MBR.
+
+  double x0 = head.mbr.min_x + BENCH_BIN_SIZE / 2.0, x1 = head.mbr.max_x - BENCH_BIN_SIZE / 2.0;
+  double y0 = head.mbr.min_y + BENCH_BIN_SIZE / 2.0, y1 = head.mbr.max_y - BENCH_BIN_SIZE / 2.0;
+  double cx = (x0 + x1) / 2.0, cy = (y0 + y1) / 2.0;
+
+  switch (bench.polygon)
+    {
+    case BENCH_DIAMOND:
+      head.polygon[0].x = cx;
+      head.polygon[0].y = y0;
+      head.polygon[1].x = x1;
+      head.polygon[1].y = cy;
+      head.polygon[2].x = cx;
+      head.polygon[2].y = y1;
+      head.polygon[3].x = x0;
+      head.polygon[3].y = cy;
+      head.polygon_count = 4;
+      break;
+
+    case BENCH_CIRCLE:
+      head.polygon_count = 64;
+      for (int32_t i = 0 ; i < head.polygon_count ; i++)
+        {
+          double angle = (double) i * 2.0 * M_PI / (double) head.polygon_count;
+
+          head.polygon[i].x = cx + (x1 - cx) * cos (angle);
+          head.polygon[i].y = cy + (y1 - cy) * sin (angle);
+        }
+      break;
+
+
+    //  A U with the notch coming down from the north edge to the middle, so the southern rows have one span and the
+    //  northern rows have two.
+
+    case BENCH_CONCAVE:
+      head.polygon[0].x = x0;
+      head.polygon[0].y = y0;
+      head.polygon[1].x = x1;
+      head.polygon[1].y = y0;
+      head.polygon[2].x = x1;
+      head.polygon[2].y = y1;
+      head.polygon[3].x = x0 + (x1 - x0) * 2.0 / 3.0;
+      head.polygon[3].y = y1;
+      head.polygon[4].x = x0 + (x1 - x0) * 2.0 / 3.0;
+      head.polygon[4].y = cy;
+      head.polygon[5].x = x0 + (x1 - x0) / 3.0;
+      head.polygon[5].y = cy;
+      head.polygon[6].x = x0 + (x1 - x0) / 3.0;
+      head.polygon[6].y = y1;
+      head.polygon[7].x = x0;
+      head.polygon[7].y = y1;
+      head.polygon_count = 8;
+      break;
+
+
+    //  Random distances from the center at evenly spaced angles.  This is always the same polygon for a given grid size.
+
+    case BENCH_RANDOM:
+      srand (1);
+      head.polygon_count = 48;
+      for (int32_t i = 0 ; i < head.polygon_count ; i++)
+        {
+          double angle = (double) i * 2.0 * M_PI / (double) head.polygon_count;
+          double radius = 0.2 + 0.8 * (double) rand () / (double) RAND_MAX;
+
+          head.polygon[i].x = cx + (x1 - cx) * radius * cos (angle);
+          head.polygon[i].y = cy + (y1 - cy) * radius * sin (angle);
+        }
+      break;
+
+    default:
+      head.polygon[0].x = x0;
+      head.polygon[0].y = y0;
+      head.polygon[1].x = x1;
+      head.polygon[1].y = y0;
+      head.polygon[2].x = x1;
+      head.polygon[2].y = y1;
+      head.polygon[3].x = x0;
+      head.polygon[3].y = y1;
+      head.polygon_count = 4;
+      break;
+    }
+
+
+  //  Move the vertices onto the nearest bin row center lines (the worst case for the row crossings).
+
+  if (bench.snap)
+    {
+      for (int32_t i = 0 ; i < head.polygon_count ; i++)
+        {
+          int32_t row = qBound (0, (int32_t) floor ((head.polygon[i].y - head.mbr.min_y) / BENCH_BIN_SIZE), bench.height - 1);
+
+          head.polygon[i].y = head.mbr.min_y + ((double) row + 0.5) * BENCH_BIN_SIZE;
+        }
+    }
+
+
+  if (bench.misp)
+    {
+      strcpy (head.average_filt_name, "AVERAGE MISP SURFACE");
+    }
+  else
+    {
+      strcpy (head.average_filt_name, "AVERAGE FILTERED DEPTH");
+    }
+
+  strcpy (head.user_flag_name[9], "PFM_USER_10");
+}
+
+
+
+synthStorage::synthStorage (MASK_BENCH *bnch, int32_t path)
+{
+  bench = *bnch;
+
+  makeHeader (&bench, &head);
+
+
+  list_files.append ("synthetic_survey.gsf");
+
+  if (path == BENCH_REMASK) list_files.append ("/SRTM_mask");
+  if (path == BENCH_DECON) list_files.append ("SRTM_data");
+
+  line_count = list_files.size ();
+
+
+  int64_t count = (int64_t) bench.width * bench.height;
+
+  bins.resize (count);
+  depth.resize (count);
+
+
+  for (int32_t i = 0 ; i < bench.height ; i++)
+    {
+      double lat = head.mbr.min_y + ((double) i + 0.5) * BENCH_BIN_SIZE;
+
+      for (int32_t j = 0 ; j < bench.width ; j++)
+        {
+          double lon = head.mbr.min_x + ((double) j + 0.5) * BENCH_BIN_SIZE;
+          BIN_RECORD *bin = &bins[(int64_t) i * bench.width + j];
+
+          memset (bin, 0, sizeof (BIN_RECORD));
+          bin->coord.x = j;
+          bin->coord.y = i;
+
+
+          //  Survey data in the water.  When we're deconflicting, the survey data also runs up onto the land near the coast.
+
+          uint8_t land = isLand (&bench, lat, lon);
+          uint8_t survey = !land;
+
+          if (land && path == BENCH_DECON && !isLand (&bench, lat, lon + bench.land * 0.1 * (double) bench.width * BENCH_BIN_SIZE))
+            survey = NVTrue;
+
+          if (survey)
+            {
+              for (int32_t k = 0 ; k < bench.points ; k++) addRecord (i, j, 10.0 + (float) k * 0.1, 0);
+            }
+
+
+          //  Previous mask records or SRTM elevations on the land.
+
+          if (land)
+            {
+              if (path == BENCH_REMASK) addRecord (i, j, -5.0, 1);
+              if (path == BENCH_DECON) addRecord (i, j, -10.0, 1);
+            }
+
+
+          BIN_RECORD tmp;
+          recomputeBin (bin->coord, &tmp);
+
+          if (bench.misp && (bin->validity & PFM_DATA)) bin->avg_filtered_depth = bin->avg_depth;
+        }
+    }
+}
+
+
+
+synthStorage::~synthStorage ()
+{
+}
+
+
+
+void 
+synthStorage::addRecord (int32_t row, int32_t col, float z, int32_t file)
+{
+  DEPTH_RECORD dep;
+
+
+  memset (&dep, 0, sizeof (DEPTH_RECORD));
+
+  dep.xyz.x = head.mbr.min_x + ((double) col + 0.5) * BENCH_BIN_SIZE;
+  dep.xyz.y = head.mbr.min_y + ((double) row + 0.5) * BENCH_BIN_SIZE;
+  dep.xyz.z = z;
+  dep.coord.x = col;
+  dep.coord.y = row;
+  dep.file_number = file;
+  dep.line_number = file;
+
+  if (file) dep.validity = PFM_USER_05 | PFM_MODIFIED;
+
+  addDepth (&dep);
+}
+
+
+
+int32_t 
+synthStorage::open (PFM_OPEN_ARGS *open_args)
+{
+  open_args->head = head;
+  open_args->max_depth = 12000.0;
+  open_args->offset = 1000.0;
+
+  return (0);
+}
+
+
+
+void 
+synthStorage::close ()
+{
+}
+
+
+
+QString 
+synthStorage::errorString ()
+{
+  return (QString ("Synthetic PFM error"));
+}
+
+
+
+QString 
+synthStorage::statusString (int32_t status)
+{
+  return (QString ("Synthetic PFM error %1").arg (status));
+}
+
+
+
+void 
+synthStorage::errorExit (int32_t status)
+{
+  fprintf (stderr, "Synthetic PFM error %d\n", status);
+  exit (-1);
+}
+
+
+
+int32_t 
+synthStorage::writeHeader (BIN_HEADER *hd)
+{
+  head = *hd;
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::listFileCount ()
+{
+  return (list_files.size ());
+}
+
+
+
+int32_t 
+synthStorage::lineCount ()
+{
+  return (line_count);
+}
+
+
+
+int32_t 
+synthStorage::readListFile (int32_t file, char *name, int16_t *type)
+{
+  if (file < 0 || file >= list_files.size ()) return (-1);
+
+  strcpy (name, list_files[file].toLatin1 ());
+  *type = PFM_NAVO_ASCII_DATA;
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::writeListFile (char *name, int16_t type __attribute__ ((unused)))
+{
+  list_files.append (QString (name));
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::writeLineFile (char *name __attribute__ ((unused)))
+{
+  line_count++;
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::readBinRow (int32_t length, int32_t row, int32_t col, BIN_RECORD *bin)
+{
+  memcpy (bin, &bins[(int64_t) row * bench.width + col], length * sizeof (BIN_RECORD));
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::readBin (NV_I32_COORD2 coord, BIN_RECORD *bin)
+{
+  *bin = bins[(int64_t) coord.y * bench.width + coord.x];
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::writeBin (BIN_RECORD *bin)
+{
+  bins[(int64_t) bin->coord.y * bench.width + bin->coord.x] = *bin;
+
+  return (SUCCESS);
+}
+
+
+
+//  Recompute the bin statistics from the valid depth records.  Like the PFM library, we leave MISP average surfaces alone.
+
+int32_t 
+synthStorage::recomputeBin (NV_I32_COORD2 coord, BIN_RECORD *bin)
+{
+  int64_t index = (int64_t) coord.y * bench.width + coord.x;
+  BIN_RECORD *rec = &bins[index];
+  QVector<DEPTH_RECORD> *dep = &depth[index];
+  double sum = 0.0, sum2 = 0.0;
+  float min_z = 0.0, max_z = 0.0;
+  int32_t valid = 0;
+
+
+  for (int32_t k = 0 ; k < dep->size () ; k++)
+    {
+      if ((*dep)[k].validity & (PFM_INVAL | PFM_DELETED)) continue;
+
+      float z = (*dep)[k].xyz.z;
+
+      if (!valid || z < min_z) min_z = z;
+      if (!valid || z > max_z) max_z = z;
+
+      sum += z;
+      sum2 += (double) z * (double) z;
+      valid++;
+    }
+
+
+  rec->num_soundings = dep->size ();
+
+  if (valid)
+    {
+      double avg = sum / (double) valid;
+
+      rec->min_depth = rec->min_filtered_depth = min_z;
+      rec->max_depth = rec->max_filtered_depth = max_z;
+      rec->avg_depth = avg;
+      rec->standard_dev = (valid > 1) ? sqrt (qMax (0.0, (sum2 - sum * avg) / (double) (valid - 1))) : 0.0;
+      if (!bench.misp) rec->avg_filtered_depth = avg;
+      rec->validity |= PFM_DATA;
+    }
+  else
+    {
+      rec->validity &= ~PFM_DATA;
+    }
+
+  *bin = *rec;
+
+  return (SUCCESS);
+}
+
+
+
+//  Check the contents of the synthetic PFM after a run of one of the code paths against a fresh copy (orig).  Bins outside the
+//  polygon and water bins must not change.  Empty land bins must have gotten a mask record (fresh), mask records must have
+//  the new land value (re-mask), and SRTM records must be invalidated in bins with survey data (deconflict).  Every bin
+//  record must match its depth records.  Returns the number of bad bins.  The first few are printed.
+
+int64_t 
+synthStorage::check (synthStorage *orig, int32_t path, MASK_PARAMS *params)
+{
+  int64_t errors = 0;
+  float   mask = params->mask;
+
+
+  bit_set (&mask, 0, 0);
+
+  for (int32_t i = 0 ; i < bench.height ; i++)
+    {
+      for (int32_t j = 0 ; j < bench.width ; j++)
+        {
+          int64_t index = (int64_t) i * bench.width + j;
+          QVector<DEPTH_RECORD> *dep = &depth[index], *old = &orig->depth[index];
+          BIN_RECORD *bin = &bins[index];
+          NV_F64_COORD2 nxy;
+          QString error;
+
+
+          nxy.x = head.mbr.min_x + ((double) j + 0.5) * BENCH_BIN_SIZE;
+          nxy.y = head.mbr.min_y + ((double) i + 0.5) * BENCH_BIN_SIZE;
+
+          uint8_t inside = bin_inside_ptr (&head, nxy);
+          uint8_t land = isLand (&bench, nxy.y, nxy.x);
+
+
+          //  The land value that the engine should have used.  With a land fraction or an SWBD mask that's coarser than the
+          //  bins we can't tell exactly which bins are land.
+
+          float value = mask;
+
+          if (params->topo) value = land ? -((float) (10 + (int16_t) fmod (fabs (nxy.y) * 3600.0, 50.0))) : 0.0;
+
+          uint8_t exact = (params->topo || (params->land_fraction == 0.0 && params->land_resolution <= 1));
+
+
+          //  Survey (file 0) records never change.
+
+          int32_t survey = 0;
+
+          for (int32_t k = 0 ; k < old->size () ; k++)
+            {
+              if ((*old)[k].file_number) continue;
+
+              survey++;
+
+              if (k >= dep->size () || (*dep)[k].validity != (*old)[k].validity || (*dep)[k].xyz.z != (*old)[k].xyz.z)
+                error = "survey record changed";
+            }
+
+
+          if (!inside || (exact && !land))
+            {
+              if (dep->size () != old->size ()) error = "records added outside the polygon or in the water";
+
+              for (int32_t k = 0 ; k < qMin (dep->size (), old->size ()) ; k++)
+                {
+                  if ((*dep)[k].validity != (*old)[k].validity || (*dep)[k].xyz.z != (*old)[k].xyz.z)
+                    error = "record changed outside the polygon or in the water";
+                }
+            }
+          else
+            {
+              switch (path)
+                {
+                case BENCH_FRESH:
+                  if (old->isEmpty () && (exact || !dep->isEmpty ()))
+                    {
+                      if (dep->size () != 1 || (*dep)[0].file_number != 1 || (*dep)[0].xyz.z != value ||
+                          (*dep)[0].validity != (PFM_USER_05 | PFM_MODIFIED))
+                        {
+                          error = "land bin not masked";
+                        }
+                      else if (bench.misp && bin->avg_filtered_depth != value)
+                        {
+                          error = "average surface isn't the mask value";
+                        }
+                    }
+                  else if (!old->isEmpty () && dep->size () != old->size ())
+                    {
+                      error = "records added to a populated bin";
+                    }
+                  break;
+
+                case BENCH_REMASK:
+                  for (int32_t k = 0 ; k < dep->size () ; k++)
+                    {
+                      if ((*dep)[k].file_number == 1 && (exact || (*dep)[k].xyz.z != (*old)[k].xyz.z) && (*dep)[k].xyz.z != value)
+                        error = "mask record not re-masked";
+                    }
+
+                  if (exact && bench.misp && !survey && bin->avg_filtered_depth != value) error = "average surface isn't the mask value";
+                  break;
+
+                case BENCH_DECON:
+                  for (int32_t k = 0 ; k < dep->size () ; k++)
+                    {
+                      uint8_t inval = ((*dep)[k].validity & PFM_INVAL) ? NVTrue : NVFalse;
+
+                      if ((*dep)[k].file_number == 1 && inval != (survey ? NVTrue : NVFalse)) error = "SRTM record not deconflicted";
+                    }
+                  break;
+                }
+            }
+
+
+          //  The bin record has to match the depth records (recompute it from a copy and compare).
+
+          BIN_RECORD saved = *bin, fresh;
+
+          recomputeBin (bin->coord, &fresh);
+          *bin = saved;
+
+          if ((fresh.validity & PFM_DATA) != (saved.validity & PFM_DATA) || fresh.num_soundings != saved.num_soundings ||
+              ((fresh.validity & PFM_DATA) && (fresh.avg_depth != saved.avg_depth || fresh.min_depth != saved.min_depth ||
+                                               fresh.max_depth != saved.max_depth)))
+            error = "bin record doesn't match its depth records";
+
+
+          if (!error.isEmpty ())
+            {
+              if (errors < 10)
+                {
+                  fprintf (stderr, "%s bin %d,%d : %s\n", maskBench::pathName (path).toLatin1 ().constData (), i, j,
+                           error.toLatin1 ().constData ());
+                  fflush (stderr);
+                }
+
+              errors++;
+            }
+        }
+    }
+
+  return (errors);
+}
+
+
+
+//  Compare the bin records with the ones from another run of the same code path (ref) byte for byte.  Returns the number of
+//  bins that are different.  The first few are printed.
+
+int64_t 
+synthStorage::compareBins (synthStorage *ref, int32_t path)
+{
+  int64_t errors = 0;
+
+
+  for (int64_t i = 0 ; i < bins.size () ; i++)
+    {
+      if (memcmp (&bins[i], &ref->bins[i], sizeof (BIN_RECORD)))
+        {
+          if (errors < 10)
+            {
+              fprintf (stderr, "%s bin %d,%d : bin record isn't the same as the read, replace, write, recompute one\n",
+                       maskBench::pathName (path).toLatin1 ().constData (), bins[i].coord.y, bins[i].coord.x);
+              fflush (stderr);
+            }
+
+          errors++;
+        }
+    }
+
+  return (errors);
+}
+
+
+
+//  Like the PFM library, this returns a malloc'ed copy of the depth records that the caller has to free.
+
+int32_t 
+synthStorage::readDepthArray (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum)
+{
+  QVector<DEPTH_RECORD> *src = &depth[(int64_t) coord.y * bench.width + coord.x];
+
+  *recnum = src->size ();
+
+  if (!*recnum) return (-1);
+
+  *dep = (DEPTH_RECORD *) malloc (*recnum * sizeof (DEPTH_RECORD));
+  memcpy (*dep, src->data (), *recnum * sizeof (DEPTH_RECORD));
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer)
+{
+  QVector<DEPTH_RECORD> *src = &depth[(int64_t) coord.y * bench.width + coord.x];
+
+  buffer->count = 0;
+
+  if (src->isEmpty ()) return (-1);
+
+  growBuffer (buffer, src->size ());
+
+  memcpy (buffer->dep, src->data (), src->size () * sizeof (DEPTH_RECORD));
+  buffer->count = src->size ();
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::updateDepth (DEPTH_RECORD *dep)
+{
+  QVector<DEPTH_RECORD> *dst = &depth[(int64_t) dep->coord.y * bench.width + dep->coord.x];
+
+  if (dep->address.record < 0 || dep->address.record >= dst->size ()) return (-1);
+
+  (*dst)[dep->address.record].validity = dep->validity;
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::changeDepth (DEPTH_RECORD *dep)
+{
+  QVector<DEPTH_RECORD> *dst = &depth[(int64_t) dep->coord.y * bench.width + dep->coord.x];
+
+  if (dep->address.record < 0 || dep->address.record >= dst->size ()) return (-1);
+
+  (*dst)[dep->address.record].xyz = dep->xyz;
+  (*dst)[dep->address.record].validity = dep->validity;
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+synthStorage::addDepth (DEPTH_RECORD *dep)
+{
+  int64_t index = (int64_t) dep->coord.y * bench.width + dep->coord.x;
+
+
+  dep->address.block = index;
+  dep->address.record = depth[index].size ();
+
+  depth[index].append (*dep);
+
+  bins[index].num_soundings++;
+
+  return (SUCCESS);
+}
+
+
+
+synthSwbd::synthSwbd (MASK_BENCH *bnch)
+{
+  bench = *bnch;
+}
+
+
+
+uint8_t 
+synthSwbd::available (int32_t resolution __attribute__ ((unused)), QString *reason __attribute__ ((unused)))
+{
+  return (NVTrue);
+}
+
+
+
+QString 
+synthSwbd::version (int32_t resolution __attribute__ ((unused)))
+{
+  return (QString ("synthetic %1").arg (bench.land, 0, 'f', 3));
+}
+
+
+
+uint8_t 
+synthSwbd::readCell (double lat, double lon, int32_t resolution __attribute__ ((unused)))
+{
+  return (synthStorage::isLand (&bench, lat, lon));
+}
+
+
+
+synthSrtm::synthSrtm (MASK_BENCH *bnch, int32_t megabytes)
+  : srtmCache (megabytes)
+{
+  bench = *bnch;
+}
+
+
+
+uint8_t 
+synthSrtm::init ()
+{
+  return (NVTrue);
+}
+
+
+
+//  Land gets a 10 to 59 meter elevation that varies with latitude.
+
+int16_t 
+synthSrtm::readCell (double lat, double lon)
+{
+  if (!synthStorage::isLand (&bench, lat, lon)) return (0);
+
+  return (10 + (int16_t) fmod (fabs (lat) * 3600.0, 50.0));
+}
+
+
+
+maskBench::maskBench (MASK_PARAMS *par, MASK_BENCH *bnch)
+{
+  params = *par;
+  bench = *bnch;
+}
+
+
+
+QString 
+maskBench::shapeName (int32_t shape)
+{
+  switch (shape)
+    {
+    case BENCH_DIAMOND:
+      return (QString ("diamond"));
+
+    case BENCH_CIRCLE:
+      return (QString ("circle"));
+
+    case BENCH_CONCAVE:
+      return (QString ("concave"));
+
+    case BENCH_RANDOM:
+      return (QString ("random"));
+    }
+
+  return (QString ("rectangle"));
+}
+
+
+
+QString 
+maskBench::pathName (int32_t path)
+{
+  switch (path)
+    {
+    case BENCH_FRESH:
+      return (QString ("fresh mask"));
+
+    case BENCH_REMASK:
+      return (QString ("re-mask"));
+
+    case BENCH_DECON:
+      return (QString ("deconflict"));
+    }
+
+  return (QString ("all"));
+}
+
+
+
+//  Time the engine on each code path.  Building the synthetic PFM isn't timed.  The sidecar files that the engine writes go to
+//  the temp directory and are removed after each run.
+
+void 
+maskBench::run ()
+{
+  QString name = QDir::tempPath () + QString ("/pfmMask_benchmark_%1.pfm").arg ((int32_t) QCoreApplication::applicationPid ());
+
+
+  for (int32_t path = 0 ; path < BENCH_PATHS ; path++)
+    {
+      if (bench.path != BENCH_PATHS && bench.path != path) continue;
+
+
+      BENCH_RESULT res;
+
+      res.path = path;
+
+      fprintf (stderr, "Building synthetic PFM for the %s path\n", pathName (path).toLatin1 ().constData ());
+      fflush (stderr);
+
+      synthStorage *store = new synthStorage (&bench, path);
+      synthSwbd swbd (&bench);
+      synthSrtm srtm (&bench, params.cache_size);
+
+
+      MASK_PARAMS par = params;
+
+      par.pfm_file = name;
+      par.verbose = NVFalse;
+      par.dry_run = NVFalse;
+      par.journal = NVFalse;
+      par.resume = NVFalse;
+
+      fprintf (stderr, "Running %s\n", pathName (path).toLatin1 ().constData ());
+      fflush (stderr);
+
+
+      QElapsedTimer bench_timer;
+      bench_timer.start ();
+
+      {
+        maskEngine engine (&par);
+
+        engine.setStorage (store);
+        engine.setCaches (&srtm, &swbd);
+
+        res.status = engine.run ();
+        res.summary = engine.summary ();
+      }
+
+      res.seconds = (double) bench_timer.elapsed () / 1000.0;
+
+
+      //  Compare the results with a fresh copy of the synthetic PFM.
+
+      res.errors = 0;
+
+      if (bench.verify && !res.status)
+        {
+          synthStorage orig (&bench, path);
+
+          res.errors = store->check (&orig, path, &par);
+        }
+
+
+      //  MISP and GMT mask bins are computed in memory and written once.  Run the same path again the old way (read,
+      //  replace, write, and recompute) and check that we get byte for byte the same bin records.
+
+      if (bench.verify && bench.misp && !res.status && path != BENCH_DECON)
+        {
+          synthStorage ref (&bench, path);
+
+          removeFiles (name);
+
+          maskEngine engine (&par);
+
+          engine.setStorage (&ref);
+          engine.setCaches (&srtm, &swbd);
+          engine.setMispRecompute (NVTrue);
+
+          if (engine.run ())
+            {
+              fprintf (stderr, "%s : %s\n", pathName (path).toLatin1 ().constData (), engine.errorString ().toLatin1 ().constData ());
+              fflush (stderr);
+              res.errors++;
+            }
+          else
+            {
+              res.errors += store->compareBins (&ref, path);
+            }
+        }
+
+      results.append (res);
+
+
+      delete store;
+
+      removeFiles (name);
+    }
+}
+
+
+
+//  Remove the sidecar files that the engine wrote for the synthetic PFM.
+
+void 
+maskBench::removeFiles (QString name)
+{
+  remove (maskIndex::indexName (name).toLatin1 ());
+  remove (maskEngine::progressName (name).toLatin1 ());
+  remove (maskEngine::reportName (name).toLatin1 ());
+  remove (landMask::cacheName (name).toLatin1 ());
+}
+
+
+
+//  Check the span classification against bin_inside_ptr for every bin of every polygon shape, with the vertices where they
+//  normally are and moved onto bin row center lines.  Returns the number of shapes that didn't match.
+
+int32_t 
+maskBench::verify ()
+{
+  int32_t failed = 0;
+
+
+  printf ("\nClassification check : %d x %d bins\n\n", bench.width, bench.height);
+  printf ("%-12s %-12s %12s %12s\n", "Polygon", "Vertices", "Inside", "Mismatches");
+
+  for (int32_t shape = 0 ; shape < BENCH_SHAPES ; shape++)
+    {
+      for (int32_t snap = 0 ; snap < 2 ; snap++)
+        {
+          MASK_BENCH bnch = bench;
+          BIN_HEADER head;
+          int64_t    inside;
+
+          bnch.polygon = shape;
+          bnch.snap = snap;
+
+          synthStorage::makeHeader (&bnch, &head);
+
+
+          MASK_PARAMS par = params;
+
+          maskEngine engine (&par);
+
+          int64_t mismatches = engine.checkClassification (&head, &inside);
+
+          printf ("%-12s %-12s %12" PRId64 " %12" PRId64 "\n", shapeName (shape).toLatin1 ().constData (),
+                  snap ? "on rows" : "normal", inside, mismatches);
+
+          if (mismatches) failed++;
+        }
+    }
+
+  printf ("\n%s\n", failed ? "Classification check FAILED" : "Classification check passed");
+  fflush (stdout);
+
+  return (failed);
+}
+
+
+
+void 
+maskBench::report ()
+{
+  double bins = (double) bench.width * (double) bench.height;
+
+
+  printf ("\nSynthetic PFM : %d x %d bins, %.0f%% land, %d points per survey bin, %s surface, %d threads%s%s\n\n", bench.width,
+          bench.height, bench.land * 100.0, bench.points, bench.misp ? "MISP" : "average filtered", params.threads,
+          params.topo ? ", SRTM topo" : "", params.stage_size > 0 ? ", staged" : "");
+
+  printf ("%-12s %8s %10s %14s %12s %12s\n", "Path", "Status", "Seconds", "Bins/sec", "Inside", "Changed");
+
+  for (int32_t i = 0 ; i < results.size () ; i++)
+    {
+      BENCH_RESULT *res = &results[i];
+
+      printf ("%-12s %8s %10.3f %14.0f %12" PRId64 " %12" PRId64 "\n", pathName (res->path).toLatin1 ().constData (),
+              (res->status || res->errors) ? "FAILED" : "OK", res->seconds, bins / (res->seconds > 0.0 ? res->seconds : 0.001), res->summary.inside,
+              res->summary.fill + res->summary.remask + res->summary.decon);
+    }
+
+  fflush (stdout);
+}
@@ -0,0 +1,227 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#ifndef MASKBENCH_H
+#define MASKBENCH_H
+
+#include "maskEngine.hpp"
+
+
+#define         BENCH_RECTANGLE     0           //  Synthetic PFM polygon shapes
+#define         BENCH_DIAMOND       1
+#define         BENCH_CIRCLE        2
+#define         BENCH_CONCAVE       3
+#define         BENCH_RANDOM        4
+#define         BENCH_SHAPES        5
+
+#define         BENCH_FRESH         0           //  Code paths (no previous mask, re-mask, SRTM deconfliction)
+#define         BENCH_REMASK        1
+#define         BENCH_DECON         2
+#define         BENCH_PATHS         3
+
+#define         BENCH_BIN_SIZE      0.0005      //  Synthetic bin size in degrees
+
+
+//  Benchmark settings.
+
+typedef struct
+{
+  int32_t       width;                      //  Synthetic grid size in bins
+  int32_t       height;
+  float         land;                       //  Fraction of the grid that is land
+  int32_t       polygon;                    //  BENCH_RECTANGLE, BENCH_DIAMOND, BENCH_CIRCLE, BENCH_CONCAVE, or BENCH_RANDOM
+  int32_t       points;                     //  Depth records in each bin with survey data
+  uint8_t       misp;                       //  MISP average surface instead of an average filtered surface
+  int32_t       path;                       //  Code path to run (BENCH_PATHS for all of them)
+  uint8_t       snap;                       //  Put the polygon vertices on bin row center lines
+  uint8_t       verify;                     //  Check the results as well as timing them
+} MASK_BENCH;
+
+
+//  Timing for one code path.
+
+typedef struct
+{
+  int32_t       path;
+  int32_t       status;
+  double        seconds;
+  MASK_SUMMARY  summary;
+  int64_t       errors;                     //  Bins with the wrong contents after the run (--verify)
+} BENCH_RESULT;
+
+
+/*!
+    Synthetic in memory PFM for benchmarking the masking engine without real data.  The west side of the grid (with a wavy
+    coastline) is land, the rest is water.  Water bins have survey data.  Depending on the code path being timed, land
+    bins are empty (fresh mask), hold a mask record from a previous run (re-mask), or hold SRTM elevations with survey data
+    overlapping the coast (deconfliction).  Nothing is written to disk.
+*/
+
+class synthStorage : public maskStorage
+{
+public:
+
+  synthStorage (MASK_BENCH *bench, int32_t path);
+  ~synthStorage ();
+
+  int32_t open (PFM_OPEN_ARGS *open_args);
+  void close ();
+  QString errorString ();
+  QString statusString (int32_t status);
+  void errorExit (int32_t status);
+
+  int32_t writeHeader (BIN_HEADER *head);
+  int32_t listFileCount ();
+  int32_t lineCount ();
+  int32_t readListFile (int32_t file, char *name, int16_t *type);
+  int32_t writeListFile (char *name, int16_t type);
+  int32_t writeLineFile (char *name);
+
+  int32_t readBinRow (int32_t length, int32_t row, int32_t col, BIN_RECORD *bin);
+  int32_t readBin (NV_I32_COORD2 coord, BIN_RECORD *bin);
+  int32_t writeBin (BIN_RECORD *bin);
+  int32_t recomputeBin (NV_I32_COORD2 coord, BIN_RECORD *bin);
+
+  int32_t readDepthArray (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum);
+  int32_t readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer);
+  int32_t updateDepth (DEPTH_RECORD *dep);
+  int32_t changeDepth (DEPTH_RECORD *dep);
+  int32_t addDepth (DEPTH_RECORD *dep);
+
+  static uint8_t isLand (MASK_BENCH *bench, double lat, double lon);
+  static void makeHeader (MASK_BENCH *bench, BIN_HEADER *head);
+  int64_t check (synthStorage *orig, int32_t path, MASK_PARAMS *params);
+
+  int64_t compareBins (synthStorage *ref, int32_t path);
+
+
+protected:
+
+  void addRecord (int32_t row, int32_t col, float z, int32_t file);
+
+
+  MASK_BENCH       bench;
+
+  BIN_HEADER       head;
+
+  QVector<BIN_RECORD> bins;
+
+  QVector<QVector<DEPTH_RECORD> > depth;
+
+  QStringList      list_files;
+
+  int32_t          line_count;
+};
+
+
+
+//  SWBD stand-in for the synthetic PFM.
+
+class synthSwbd : public swbdCache
+{
+public:
+
+  synthSwbd (MASK_BENCH *bnch);
+
+  uint8_t available (int32_t resolution, QString *reason);
+  QString version (int32_t resolution);
+
+
+protected:
+
+  uint8_t readCell (double lat, double lon, int32_t resolution);
+
+
+  MASK_BENCH       bench;
+};
+
+
+
+//  SRTM stand-in for the synthetic PFM.
+
+class synthSrtm : public srtmCache
+{
+public:
+
+  synthSrtm (MASK_BENCH *bnch, int32_t megabytes);
+
+  uint8_t init ();
+
+
+protected:
+
+  int16_t readCell (double lat, double lon);
+
+
+  MASK_BENCH       bench;
+};
+
+
+
+/*!
+    Runs the masking engine on a synthetic PFM for each of the requested code paths and times it.  With --verify it also
+    checks the results.
+*/
+
+class maskBench
+{
+public:
+
+  maskBench (MASK_PARAMS *par, MASK_BENCH *bnch);
+
+  void run ();
+  int32_t verify ();
+  void report ();
+
+  static QString shapeName (int32_t shape);
+  static QString pathName (int32_t path);
+
+
+  QVector<BENCH_RESULT> results;
+
+
+protected:
+
+  void removeFiles (QString name);
+
+
+  MASK_PARAMS      params;
+
+  MASK_BENCH       bench;
+};
+
+#endif
@@ -0,0 +1,2386 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "maskEngine.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#ifdef NVWIN3X
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+
+//  The PFM library isn't thread safe so when more than one engine is running (batch mode with --jobs) they take turns.  The
+//  classification and land mask work isn't done in the library so it overlaps with the other engines' PFM I/O.
+
+QMutex maskEngine::pfm_mutex;
+
+
+
+maskEngine::maskEngine (MASK_PARAMS *par, QObject *parent)
+  : QObject (parent)
+{
+  params = *par;
+
+  storage = new pfmStorage;
+  own_storage = NVTrue;
+  width = height = 0;
+  misp = NVFalse;
+  misp_recompute = NVFalse;
+  decon = 0;
+  mask_file = 0;
+  file_count = 0;
+  line_count = 0;
+  add_file = NVFalse;
+  last_progress = 0;
+  old_percent = -1;
+  block_start = 0;
+  srtm = NULL;
+  swbd = NULL;
+  own_srtm = own_swbd = NVFalse;
+  land_res = 1;
+  land_cached = NVFalse;
+  skip_water = NVFalse;
+  use_index = NVFalse;
+  repair_file = -1;
+  dirty_row_bytes = 0;
+  dirty_count = 0;
+  dirty_row0 = 0;
+  dirty_row1 = -1;
+
+  memset (&plan_summary, 0, sizeof (MASK_SUMMARY));
+  memset (&stats, 0, sizeof (MASK_STATS));
+  memset (&depth_buffer, 0, sizeof (DEPTH_BUFFER));
+
+
+  //  Clear the low bit of the mask value (same as we've always done in the wizard).
+
+  mask = params.mask;
+  bit_set (&mask, 0, 0);
+
+
+  //  Nothing gets changed in a dry run so there's nothing to journal (or stage).
+
+  if (params.dry_run)
+    {
+      params.journal = NVFalse;
+      params.stage_size = 0;
+    }
+
+
+  //  Do all of the work in memory and write it back in one pass.
+
+  if (params.stage_size > 0) storage = new stagingStorage (storage, params.stage_size);
+}
+
+
+
+maskEngine::~maskEngine ()
+{
+  storage->close ();
+  if (own_storage) delete storage;
+
+  if (own_srtm) delete srtm;
+  if (own_swbd) delete swbd;
+
+  maskStorage::freeBuffer (&depth_buffer);
+}
+
+
+
+//  Use a different storage backend instead of the PFM library.  The engine doesn't take ownership.  This has to be called before
+//  run.  If we're staging, the staging wrapper (which we do own) goes around the new backend.
+
+void 
+maskEngine::setStorage (maskStorage *store)
+{
+  if (own_storage) delete storage;
+
+  storage = store;
+  own_storage = NVFalse;
+
+  if (params.stage_size > 0)
+    {
+      storage = new stagingStorage (store, params.stage_size, NVFalse);
+      own_storage = NVTrue;
+    }
+}
+
+
+
+//  Use shared SRTM and SWBD caches instead of creating our own.  This has to be called before run.
+
+void 
+maskEngine::setCaches (srtmCache *topo_cache, swbdCache *land_cache)
+{
+  srtm = topo_cache;
+  swbd = land_cache;
+}
+
+
+
+//  Update the mask bins of MISP and GMT surfaces the old way (read, replace, write, and recompute) instead of computing the
+//  bin record and writing it once.  The benchmark uses this to check that the two give the same bin records.  This has to
+//  be called before run.
+
+void 
+maskEngine::setMispRecompute (uint8_t recompute)
+{
+  misp_recompute = recompute;
+}
+
+
+
+QString
+maskEngine::errorString ()
+{
+  return (error_string);
+}
+
+
+
+MASK_SUMMARY
+maskEngine::summary ()
+{
+  return (plan_summary);
+}
+
+
+
+//  Check to see if SRTM elevation data has already been loaded into the PFM.  This opens the file read only (no checkpoint)
+//  so that the front end can ask the user whether they want to deconflict before we start the real run.
+
+uint8_t 
+maskEngine::srtmDataLoaded (QString pfm_file)
+{
+  PFM_OPEN_ARGS open_args;
+  uint8_t       found = NVFalse;
+
+
+  QMutexLocker lock (&pfm_mutex);
+
+
+  strcpy (open_args.list_path, pfm_file.toLatin1 ());
+
+  open_args.checkpoint = 0;
+  int32_t hnd = open_existing_pfm_file (&open_args);
+
+  if (hnd < 0) return (NVFalse);
+
+
+  int32_t count = get_next_list_file_number (hnd);
+
+  for (int16_t i = 0 ; i < count ; i++)
+    {
+      char filename[512];
+      int16_t type;
+
+      read_list_file (hnd, i, filename, &type);
+
+      if (strstr (filename, "SRTM_data"))
+        {
+          found = NVTrue;
+          break;
+        }
+    }
+
+  close_pfm_file (hnd);
+
+  return (found);
+}
+
+
+
+//  Open the PFM file (with a checkpoint in case we barf) and make sure everything we need is available.  In a dry run we
+//  don't checkpoint the file and we don't write anything to it.  If we're journaling we don't checkpoint the file either,
+//  the before images of everything we change go to the undo journal.
+
+int32_t 
+maskEngine::openPFM ()
+{
+  if (params.dry_run || params.journal || params.resume)
+    {
+      emit phase (tr ("Opening PFM file"), 0, PHASE_ROWS);
+    }
+  else
+    {
+      emit phase (tr ("Creating checkpoint file"), 0, PHASE_ROWS);
+    }
+
+
+  strcpy (open_args.list_path, params.pfm_file.toLatin1 ());
+
+
+  //  Check point the file in case we barf.  If we're resuming, the checkpoint from the interrupted run is the one we want to
+  //  keep.
+
+  open_args.checkpoint = (params.dry_run || params.journal || params.resume) ? 0 : 1;
+  if (storage->open (&open_args))
+    {
+      error_string = tr ("The file %1 is not a PFM file or there was an error reading the file.  The error message returned was:\n\n%2").arg
+        (QDir::toNativeSeparators (params.pfm_file)).arg (storage->errorString ());
+      return (-1);
+    }
+
+
+  stagingStorage *stage = dynamic_cast<stagingStorage *> (storage);
+
+  if (stage && !stage->isStaged () && params.verbose)
+    {
+      fprintf (stderr, "The bin grid doesn't fit in %d MB, working directly on the PFM\n", params.stage_size);
+      fflush (stderr);
+    }
+
+
+  //  Check the mask value.
+
+  if (params.mask < -open_args.offset || params.mask > open_args.max_depth)
+    {
+      error_string = tr ("The mask value (%1) is outside of the PFM Z bounds (%2 to %3).").arg
+        (params.mask, 0, 'f', 2).arg (-open_args.offset, 0, 'f', 2).arg (open_args.max_depth, 0, 'f', 2);
+      return (-1);
+    }
+
+
+  //  We're going to try to use PFM_USER_10 as a landmask tag (assuming it hasn't been used yet).
+
+  if (strcmp (open_args.head.user_flag_name[9], "PFM_USER_10") && strcmp (open_args.head.user_flag_name[9], "Land masked point"))
+    {
+      error_string = tr ("Unable to use PFM_USER_10 flag for land masked data.\nFlag already in use for %1").arg (open_args.head.user_flag_name[9]);
+      return (-1);
+    }
+
+
+  //  Check to see if the land mask is available.
+
+  if (params.topo)
+    {
+      if (!srtm)
+        {
+          srtm = new srtmCache (params.cache_size);
+          own_srtm = NVTrue;
+        }
+
+
+      //  The SRTM reader is shared with the other engines in batch mode so we only touch it through the cache.
+
+      if (!srtm->init ())
+        {
+          error_string = tr ("SRTM topo data is not available.  Check your ABE_DATA environment variable.");
+          return (-1);
+        }
+    }
+  else
+    {
+      if (!swbd)
+        {
+          swbd = new swbdCache;
+          own_swbd = NVTrue;
+        }
+
+      QString reason;
+
+      if (params.land_resolution)
+        {
+          land_res = swbd->available (params.land_resolution, &reason) ? params.land_resolution : 0;
+        }
+      else
+        {
+          double bin_seconds = qMin (open_args.head.x_bin_size_degrees, open_args.head.y_bin_size_degrees) * 3600.0;
+
+          land_res = swbd->matchResolution (bin_seconds, &reason);
+        }
+
+      if (!land_res)
+        {
+          error_string = tr ("The SWBD mask is not avalable for the following reason : \n\n") + reason;
+          return (-1);
+        }
+
+      if (params.verbose)
+        {
+          fprintf (stderr, "Using the %d second SWBD mask\n", land_res);
+          fflush (stderr);
+        }
+    }
+
+
+  width = open_args.head.bin_width;
+  height = open_args.head.bin_height;
+
+
+  //  Check to see if the average surface is a MISP or GMT surface.
+
+  if (strstr (open_args.head.average_filt_name, "MINIMUM MISP") || strstr (open_args.head.average_filt_name, "AVERAGE MISP") ||
+      strstr (open_args.head.average_filt_name, "MAXIMUM MISP") || strstr (open_args.head.average_filt_name, "MINIMUM GMT") ||
+      strstr (open_args.head.average_filt_name, "AVERAGE GMT") || strstr (open_args.head.average_filt_name, "MAXIMUM GMT"))
+    misp = NVTrue;
+
+
+  //  Start this run's section of the undo journal (with the flag name that we're about to replace).
+
+  if (params.journal)
+    {
+      QString name = maskJournal::journalName (params.pfm_file);
+
+      if (!journal.open (name) || !journal.run (open_args.head.user_flag_name[9], misp))
+        {
+          error_string = tr ("Unable to write to the journal file %1 : %2").arg (QDir::toNativeSeparators (name)).arg (strerror (errno));
+          return (-1);
+        }
+    }
+
+
+  if (!params.dry_run)
+    {
+      strcpy (open_args.head.user_flag_name[9], "Land masked point");
+
+      storage->writeHeader (&open_args.head);
+    }
+
+
+  return (0);
+}
+
+
+
+//  Check to see if we already have SRTM data or a previous mask in the PFM file.
+
+void 
+maskEngine::scanListFiles ()
+{
+  file_count = storage->listFileCount ();
+  line_count = storage->lineCount ();
+
+  for (int16_t i = 0 ; i < file_count ; i++)
+    {
+      char filename[512];
+      int16_t type;
+
+      storage->readListFile (i, filename, &type);
+
+
+      if (strstr (filename, "SRTM_mask")) mask_file = i;
+
+
+      if (strstr (filename, "SRTM_data"))
+        {
+          if (params.deconflict) decon = i;
+          break;
+        }
+    }
+
+
+  if (mask_file)
+    {
+      decon = 0;
+      file_count = mask_file;
+    }
+}
+
+
+
+//  Used when the engine has been moved to a worker thread (i.e. from the wizard).  Connect the thread's started signal to this.
+
+void 
+maskEngine::slotRun ()
+{
+  int32_t status = run ();
+
+  emit finished (status);
+}
+
+
+
+//  Run the masking engine and write the JSON run report.  The SWBD and SRTM caches may be shared (batch mode) so the cache
+//  lookups are counted by the land mask (SWBD) and the stripes (SRTM), not by the caches.
+
+int32_t 
+maskEngine::run ()
+{
+  memset (&stats, 0, sizeof (MASK_STATS));
+
+
+  QElapsedTimer total_timer;
+  total_timer.start ();
+
+  int32_t status = process ();
+
+  stats.total_time = (double) total_timer.nsecsElapsed () * 1.0e-9;
+
+
+  stats.bins_inside = plan_summary.inside;
+  stats.swbd_lookups = land.lookups;
+  stats.swbd_hits = land.hits;
+
+
+  if (!params.dry_run) writeReport (status);
+
+  return (status);
+}
+
+
+
+MASK_STATS 
+maskEngine::statistics ()
+{
+  return (stats);
+}
+
+
+
+//  Add the time since the phase timer was (re)started to a total and restart it.
+
+void 
+maskEngine::addTime (double *total)
+{
+  *total += (double) phase_timer.nsecsElapsed () * 1.0e-9;
+  phase_timer.start ();
+}
+
+
+
+//  This is where the fun stuff happens.
+
+int32_t 
+maskEngine::process ()
+{
+  MASK_PROGRESS prog;
+  int32_t       start_row = 0;
+
+
+  //  If we're resuming an interrupted run we have to use the parameters that it was started with.
+
+  if (params.resume)
+    {
+      if (!readProgress (&prog))
+        {
+          error_string = tr ("Unable to read a progress record for %1 from %2").arg (QDir::toNativeSeparators (params.pfm_file)).arg
+            (QDir::toNativeSeparators (progressName (params.pfm_file)));
+          return (-1);
+        }
+
+      params.mask = prog.mask;
+      params.topo = prog.topo;
+      params.deconflict = prog.deconflict;
+      params.land_resolution = prog.land_resolution;
+      params.land_fraction = prog.land_fraction;
+      if (!params.dry_run) params.journal = prog.journal;
+
+      mask = params.mask;
+      bit_set (&mask, 0, 0);
+    }
+
+
+  //  We only hold the PFM library lock while we're using the library.
+
+  QMutexLocker lock (&pfm_mutex);
+
+  phase_timer.start ();
+
+
+  if (openPFM ())
+    {
+      storage->close ();
+      return (-1);
+    }
+
+
+  //  The interrupted run may have added the SRTM_mask list file so we can't look at the list files again.
+
+  if (params.resume)
+    {
+      decon = prog.decon;
+      mask_file = prog.mask_file;
+      file_count = prog.file_count;
+      line_count = prog.line_count;
+      add_file = prog.add_file;
+      start_row = prog.row;
+
+
+      //  Bins after the last commit may have been changed without being recomputed (or, for MISP surfaces, without getting
+      //  their average surface) before the run was interrupted.  Those are the bins with records from the file that the
+      //  interrupted run was adding or invalidating.
+
+      repair_file = decon ? decon : (mask_file ? mask_file : file_count);
+    }
+  else
+    {
+      scanListFiles ();
+    }
+
+
+  if (!params.dry_run) writeProgress (start_row);
+
+
+  //  If we've masked this file before, load the index of bins with mask records so that we don't have to read the depth
+  //  array of every populated bin to find them.  If there's no index (or it doesn't match) we build it as we go.  A resumed
+  //  run doesn't know which bins the interrupted run filled so we get rid of the index and the next run will rebuild it (a
+  //  dry run doesn't change anything so it leaves it alone).
+
+  if (params.resume)
+    {
+      if (!params.dry_run) remove (maskIndex::indexName (params.pfm_file).toLatin1 ());
+      index.setup (&open_args.head);
+    }
+  else if (!decon)
+    {
+      if (mask_file) use_index = index.read (maskIndex::indexName (params.pfm_file), &open_args.head, mask_file);
+
+      if (!use_index) index.setup (&open_args.head);
+    }
+
+  addTime (&stats.open_time);
+
+
+  lock.unlock ();
+
+
+  //  Rasterize the SWBD mask onto the bin grid before we start (we don't need it if we're deconflicting).
+
+  if (!params.topo && !decon)
+    {
+      phase_timer.start ();
+      buildLandMask ();
+      addTime (&stats.land_mask_time);
+    }
+
+
+  //  When we're only filling empty bins from the SWBD mask we can use the land mask pyramid to skip all water blocks.  We
+  //  don't do this in a dry run since we want to count all of the bins inside the polygon.
+
+  skip_water = (!params.topo && !decon && !mask_file && !params.dry_run);
+
+
+  QString title;
+
+  if (decon)
+    {
+      title = tr ("Planning SRTM deconfliction");
+    }
+  else
+    {
+      title = tr ("Planning land fill");
+    }
+
+  emit phase (title, height, PHASE_ROWS);
+
+
+  //  We work on blocks of rows.  Each block is split into row stripes and the stripes are classified by the worker threads.
+  //  The bin headers for the block are read here, in this thread, in row order and then we plan what needs to be done.  The
+  //  plan is applied once we've planned all of the rows (or the plan gets too big).
+
+  if (params.threads < 1) params.threads = 1;
+
+  int32_t block = params.threads * BLOCK_ROWS;
+
+  cells.resize (block * width);
+  bin_row.resize (width);
+
+
+  //  Bins that need to be recomputed after we apply the plan.
+
+  setupDirty ();
+
+
+  QThreadPool pool;
+  pool.setMaxThreadCount (params.threads);
+
+
+  old_percent = -1;
+  timer.start ();
+  last_progress = 0;
+
+  QElapsedTimer commit_timer;
+  commit_timer.start ();
+
+  storage->readAhead (start_row, qMin (start_row + block, height));
+
+  for (int32_t row0 = start_row ; row0 < height ; row0 += block)
+    {
+      int32_t row1 = qMin (row0 + block, height);
+
+      block_start = row0;
+
+
+      //  Get the kernel started on the next block's bin rows while we work on this one.
+
+      storage->readAhead (row1, qMin (row1 + block, height));
+
+      phase_timer.start ();
+      runStripes (&pool, MASK_STAGE_CLASSIFY, row0, row1);
+      addTime (&stats.classify_time);
+
+      lock.relock ();
+      phase_timer.start ();
+      readBins (row0, row1);
+      addTime (&stats.bin_read_time);
+      lock.unlock ();
+
+      runStripes (&pool, MASK_STAGE_LAND, row0, row1);
+      addTime (&stats.land_value_time);
+
+      lock.relock ();
+      phase_timer.start ();
+      planBins (row0, row1);
+      addTime (&stats.plan_time);
+
+
+      //  In a dry run we only want the summary.
+
+      if (params.dry_run) plan.clear ();
+
+
+      //  Don't let the plan get too big.  Bins don't depend on each other so we can apply what we have and keep going.  We
+      //  also apply the plan every so often so that we can commit our progress in case the run is interrupted.
+
+      if ((plan.size () >= PLAN_SIZE || (!params.dry_run && commit_timer.elapsed () >= COMMIT_INTERVAL)) && row1 < height)
+        {
+          if (applyPlan ())
+            {
+              closePFM ();
+              return (-1);
+            }
+
+          int32_t status = storage->flush ();
+          if (status) storage->errorExit (status);
+
+          writeProgress (row1);
+          commit_timer.restart ();
+
+          emit phase (title, height, PHASE_ROWS);
+          last_progress = timer.elapsed ();
+        }
+
+      lock.unlock ();
+
+
+      reportProgress (row1);
+    }
+
+
+  if (params.verbose)
+    {
+      fprintf (stderr, "100%% processed    \n");
+      fflush (stderr);
+    }
+
+
+  lock.relock ();
+
+  if (params.dry_run)
+    {
+      plan.clear ();
+    }
+  else if (applyPlan ())
+    {
+      closePFM ();
+      return (-1);
+    }
+
+
+  phase_timer.start ();
+
+
+  //  Save the index of bins with mask records for the next run.
+
+  if (!decon && !params.dry_run && !params.resume && (add_file || mask_file))
+    {
+      if (!index.write (maskIndex::indexName (params.pfm_file), &open_args.head, mask_file ? mask_file : file_count, mask,
+                        params.topo) && params.verbose)
+        {
+          fprintf (stderr, "Unable to write mask index file %s\n", maskIndex::indexName (params.pfm_file).toLatin1 ().constData ());
+          fflush (stderr);
+        }
+    }
+
+
+  cells.clear ();
+  bin_row.clear ();
+  dirty.clear ();
+  land.clear ();
+  index.clear ();
+
+  closePFM ();
+
+  addTime (&stats.close_time);
+
+
+  //  We made it all the way through so we won't be resuming this run.
+
+  remove (progressName (params.pfm_file).toLatin1 ());
+
+  return (0);
+}
+
+
+
+//  Only send progress a few times a second.  The GUI is in another thread so this is a queued signal and there's no point in
+//  flooding its event loop.
+
+void 
+maskEngine::reportProgress (int32_t rows)
+{
+  int64_t now = timer.elapsed ();
+
+  if (rows == height || now - last_progress >= PROGRESS_INTERVAL)
+    {
+      emit progress (rows, (double) rows * (double) width * 1000.0 / (double) (now ? now : 1));
+      last_progress = now;
+    }
+
+
+  if (params.verbose)
+    {
+      int32_t percent = NINT (((float) rows / (float) height) * 100.0);
+      if (percent != old_percent)
+        {
+          fprintf (stderr, "%03d%% processed    \r", percent);
+          fflush (stderr);
+          old_percent = percent;
+        }
+    }
+}
+
+
+
+//  Split the rows of a block into one stripe per thread and run the requested stage on them.  If we're only using one
+//  thread we just do it here.
+
+void 
+maskEngine::runStripes (QThreadPool *pool, int32_t stage, int32_t row0, int32_t row1)
+{
+  if (params.threads == 1)
+    {
+      stripe (stage, row0, row1);
+      return;
+    }
+
+
+  int32_t rows = (row1 - row0 + params.threads - 1) / params.threads;
+
+  for (int32_t r = row0 ; r < row1 ; r += rows) pool->start (new maskStripe (this, stage, r, qMin (r + rows, row1)));
+
+  pool->waitForDone ();
+}
+
+
+
+//  The part of the work that doesn't touch the PFM file.  This is called from the worker threads so it can only modify the
+//  cells in its own stripe.
+
+void 
+maskEngine::stripe (int32_t stage, int32_t row0, int32_t row1)
+{
+  QVector<double> cross;
+  int64_t         visited = 0, lookups = 0, hits = 0;
+
+
+  for (int32_t i = row0 ; i < row1 ; i++)
+    {
+      MASK_CELL *cell = &cells[(i - block_start) * width];
+
+      switch (stage)
+        {
+        case MASK_STAGE_CLASSIFY:
+          visited += classifyRow (i, cell, &cross);
+          break;
+
+        case MASK_STAGE_LAND:
+          landRow (i, cell, &lookups, &hits);
+          break;
+        }
+    }
+
+
+  if (visited || lookups)
+    {
+      QMutexLocker lock (&stats_mutex);
+      stats.bins_visited += visited;
+      stats.srtm_lookups += lookups;
+      stats.srtm_hits += hits;
+    }
+}
+
+
+
+//  Find where the center line of a row crosses the PFM polygon edges (even-odd rule).  The crossings are returned, sorted,
+//  in bin column units (i.e. column j's center is at j).  If a polygon vertex is (nearly) on the center line we return
+//  NVFalse and the caller has to test every bin in the row.
+
+uint8_t 
+maskEngine::rowCrossings (double y, QVector<double> *cross)
+{
+  int32_t count = open_args.head.polygon_count;
+  NV_F64_COORD2 *poly = open_args.head.polygon;
+  double eps = open_args.head.y_bin_size_degrees * 1.0e-6;
+
+
+  cross->clear ();
+
+  if (count < 3) return (NVFalse);
+
+
+  for (int32_t k = 0, m = count - 1 ; k < count ; m = k++)
+    {
+      if (fabs (poly[k].y - y) < eps) return (NVFalse);
+
+      if ((poly[k].y > y) != (poly[m].y > y))
+        {
+          double x = poly[k].x + (y - poly[k].y) * (poly[m].x - poly[k].x) / (poly[m].y - poly[k].y);
+
+          cross->append ((x - open_args.head.mbr.min_x) / open_args.head.x_bin_size_degrees - 0.5);
+        }
+    }
+
+  std::sort (cross->begin (), cross->end ());
+
+  return (NVTrue);
+}
+
+
+
+//  Figure out which bins in a row are inside the PFM polygon.  Instead of testing every bin we compute the interior spans of
+//  the row.  Bins well inside a span are inside and bins well outside all spans are outside.  Bins within one bin of a
+//  crossing are still checked with bin_inside_ptr so that we get exactly the same answer the PFM library would give us.
+//  Returns the number of bins that we looked at.
+
+int32_t 
+maskEngine::classifyRow (int32_t row, MASK_CELL *cell, QVector<double> *cross)
+{
+  NV_F64_COORD2 nxy;
+  int32_t       n, visited = 0;
+
+
+  memset (cell, 0, width * sizeof (MASK_CELL));
+
+  nxy.y = open_args.head.mbr.min_y + (double) row * open_args.head.y_bin_size_degrees + open_args.head.y_bin_size_degrees / 2.0;
+
+
+  //  Can't use spans for this row so we check every bin.
+
+  if (!rowCrossings (nxy.y, cross))
+    {
+      for (int32_t j = 0 ; j < width ; j++)
+        {
+          if (skip_water && (n = land.run (row, j, LAND_NONE)))
+            {
+              j += n - 1;
+              continue;
+            }
+
+          classifyBin (row, j, cell, NVFalse);
+          visited++;
+        }
+
+      return (visited);
+    }
+
+
+  for (int32_t k = 0 ; k + 1 < cross->size () ; k += 2)
+    {
+      double left = cross->at (k), right = cross->at (k + 1);
+
+      int32_t j0 = qMax (0, (int32_t) floor (left) - 1);
+      int32_t j1 = qMin (width - 1, (int32_t) ceil (right) + 1);
+
+      for (int32_t j = j0 ; j <= j1 ; j++)
+        {
+          //  If we're just filling empty land bins from the SWBD mask there's nothing to do in all water blocks so we
+          //  don't even have to read the bins.
+
+          if (skip_water && (n = land.run (row, j, LAND_NONE)))
+            {
+              j += n - 1;
+              continue;
+            }
+
+          classifyBin (row, j, cell, ((double) j > left + 1.0 && (double) j < right - 1.0));
+          visited++;
+        }
+    }
+
+  return (visited);
+}
+
+
+
+//  Set the inside flag and index for a single bin.  If we don't already know that it's inside we ask the PFM library.
+
+void 
+maskEngine::classifyBin (int32_t row, int32_t col, MASK_CELL *cell, uint8_t inside)
+{
+  NV_F64_COORD2 nxy;
+
+
+  nxy.x = open_args.head.mbr.min_x + (double) col * open_args.head.x_bin_size_degrees + open_args.head.x_bin_size_degrees / 2.0;
+  nxy.y = open_args.head.mbr.min_y + (double) row * open_args.head.y_bin_size_degrees + open_args.head.y_bin_size_degrees / 2.0;
+
+  cell[col].inside = inside ? NVTrue : bin_inside_ptr (&open_args.head, nxy);
+
+  if (cell[col].inside) compute_index_ptr (nxy, &cell[col].coord, &open_args.head);
+}
+
+
+
+//  Classify every bin of a bin grid with the row spans (classifyRow) and with bin_inside_ptr and return the number of bins
+//  where they don't agree.  This is for the benchmark's --verify check and doesn't touch a PFM.
+
+int64_t 
+maskEngine::checkClassification (BIN_HEADER *head, int64_t *inside)
+{
+  QVector<MASK_CELL> row;
+  QVector<double>    cross;
+  NV_F64_COORD2      nxy;
+  int64_t            mismatches = 0;
+
+
+  open_args.head = *head;
+  width = head->bin_width;
+  height = head->bin_height;
+  skip_water = NVFalse;
+
+  row.resize (width);
+  *inside = 0;
+
+
+  for (int32_t i = 0 ; i < height ; i++)
+    {
+      classifyRow (i, row.data (), &cross);
+
+      nxy.y = head->mbr.min_y + (double) i * head->y_bin_size_degrees + head->y_bin_size_degrees / 2.0;
+
+      for (int32_t j = 0 ; j < width ; j++)
+        {
+          nxy.x = head->mbr.min_x + (double) j * head->x_bin_size_degrees + head->x_bin_size_degrees / 2.0;
+
+          uint8_t in = bin_inside_ptr (head, nxy) ? NVTrue : NVFalse;
+
+          if (in) (*inside)++;
+
+          if ((row[j].inside ? NVTrue : NVFalse) != in)
+            {
+              if (mismatches < 10)
+                {
+                  fprintf (stderr, "Bin %d,%d : spans say %s, bin_inside_ptr says %s\n", i, j, row[j].inside ? "inside" : "outside",
+                           in ? "inside" : "outside");
+                  fflush (stderr);
+                }
+
+              mismatches++;
+            }
+        }
+    }
+
+  return (mismatches);
+}
+
+
+
+//  Get the land values for the bins in a row that need them.  SRTM cache lookups are added to lookups and hits.
+
+void 
+maskEngine::landRow (int32_t row, MASK_CELL *cell, int64_t *lookups, int64_t *hits)
+{
+  NV_F64_COORD2 nxy;
+  int32_t       n;
+
+
+  nxy.y = open_args.head.mbr.min_y + (double) row * open_args.head.y_bin_size_degrees + open_args.head.y_bin_size_degrees / 2.0;
+
+  for (int32_t j = 0 ; j < width ; j++)
+    {
+      //  All land blocks get the mask value without looking at the bits.
+
+      if (skip_water && (n = land.run (row, j, LAND_ALL)))
+        {
+          for (int32_t k = j ; k < j + n ; k++) if (cell[k].need) cell[k].value = mask;
+          j += n - 1;
+          continue;
+        }
+
+      if (cell[j].need)
+        {
+          nxy.x = open_args.head.mbr.min_x + (double) j * open_args.head.x_bin_size_degrees + open_args.head.x_bin_size_degrees / 2.0;
+          cell[j].value = landValue (cell[j].coord, nxy, lookups, hits);
+        }
+    }
+}
+
+
+
+//  Read the bin records for the block and figure out which bins will need a land value.  We read each row in one shot
+//  (from the first to the last bin that we need in the row) so the bin file is read sequentially.
+
+void 
+maskEngine::readBins (int32_t row0, int32_t row1)
+{
+  for (int32_t i = row0 ; i < row1 ; i++)
+    {
+      MASK_CELL *cell = &cells[(i - block_start) * width];
+
+
+      int32_t first = width, last = -1;
+
+      for (int32_t j = 0 ; j < width ; j++)
+        {
+          if (cell[j].inside)
+            {
+              if (first == width) first = j;
+              last = j;
+            }
+        }
+
+      if (last < 0) continue;
+
+
+      storage->readBinRow (last - first + 1, i, first, bin_row.data ());
+
+      stats.bin_row_reads++;
+      stats.bins_read += last - first + 1;
+
+      for (int32_t j = first ; j <= last ; j++)
+        {
+          if (cell[j].inside)
+            {
+              cell[j].validity = bin_row[j - first].validity;
+              cell[j].avg = bin_row[j - first].avg_filtered_depth;
+
+
+              //  Empty bins get masked if they're land (unless we're deconflicting).
+
+              if (!decon && !(cell[j].validity & PFM_DATA)) cell[j].need = NVTrue;
+            }
+        }
+    }
+}
+
+
+
+//  Read a bin's depth array (counted and timed for the run report).  The records are read into the engine's depth buffer, which
+//  is reused for every bin, so dep is only good until the next read and must not be freed.
+
+int32_t 
+maskEngine::readDepth (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum)
+{
+  QElapsedTimer read_timer;
+  read_timer.start ();
+
+  int32_t status = storage->readDepthBuffer (coord, &depth_buffer);
+
+  *dep = depth_buffer.dep;
+  *recnum = depth_buffer.count;
+
+  stats.depth_read_time += (double) read_timer.nsecsElapsed () * 1.0e-9;
+  stats.depth_reads++;
+  if (!status) stats.depth_records_read += *recnum;
+
+  return (status);
+}
+
+
+
+//  When resuming, see if a bin has records from the file that the interrupted run was adding (or invalidating).  If it does
+//  the bin may not have been recomputed so we set up a MASK_REPAIR action for it.  If the bin only has mask records the
+//  value is the mask value (so that we can put it back in a MISP or GMT average surface), otherwise it's 0.0 and we just
+//  recompute the bin.  Recomputing a bin that was finished is harmless.
+
+uint8_t 
+maskEngine::repairBin (MASK_ACTION *act)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+  uint8_t      found = NVFalse, other = NVFalse;
+  float        value = 0.0;
+
+
+  if (repair_file < 0 || readDepth (act->coord, &dep, &recnum)) return (NVFalse);
+
+
+  for (int32_t k = 0 ; k < recnum ; k++)
+    {
+      if (dep[k].validity & PFM_DELETED) continue;
+
+      if (dep[k].file_number == repair_file)
+        {
+          found = NVTrue;
+          if (!(dep[k].validity & PFM_INVAL) && value == 0.0) value = dep[k].xyz.z;
+        }
+      else if (!(dep[k].validity & PFM_INVAL))
+        {
+          other = NVTrue;
+        }
+    }
+
+  if (!found) return (NVFalse);
+
+
+  act->action = MASK_REPAIR;
+  act->value = other ? 0.0 : value;
+
+  plan_summary.repair++;
+
+  return (NVTrue);
+}
+
+
+
+//  Check the contents of a bin's depth array.  Sets srtm if there are valid records from the SRTM file and valid if there are
+//  valid records from any other file.  If count isn't NULL it is set to the number of valid records from the SRTM file.
+//  Returns NVFalse if we couldn't read the depth array.
+
+uint8_t 
+maskEngine::binContents (NV_I32_COORD2 coord, int32_t file, uint8_t *srtm, uint8_t *valid, int32_t *count)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+
+
+  *srtm = *valid = NVFalse;
+  if (count) *count = 0;
+
+  if (readDepth (coord, &dep, &recnum)) return (NVFalse);
+
+
+  for (int32_t k = 0 ; k < recnum ; k++)
+    {
+      if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)))
+        {
+          if (dep[k].file_number == file)
+            {
+              *srtm = NVTrue;
+              if (count) (*count)++;
+              if (*valid && !count) break;
+            }
+          else
+            {
+              *valid = NVTrue;
+              if (*srtm && !count) break;
+            }
+        }
+    }
+
+  return (NVTrue);
+}
+
+
+
+//  Planning pass for a block.  Nothing is written here, we just decide what has to be done to each bin (and with what value)
+//  and add it to the plan.  The plan is in row order which is the order of the bin file.  We also keep the summary counts
+//  (the bins inside count doesn't include skipped water blocks unless this is a dry run).
+
+void 
+maskEngine::planBins (int32_t row0, int32_t row1)
+{
+  MASK_ACTION act;
+  uint8_t     srtm, valid;
+  int32_t     count;
+
+
+  for (int32_t i = row0 ; i < row1 ; i++)
+    {
+      MASK_CELL *cell = &cells[(i - block_start) * width];
+
+      for (int32_t j = 0 ; j < width ; j++)
+        {
+          if (!cell[j].inside) continue;
+
+
+          act.coord = cell[j].coord;
+          act.value = cell[j].value;
+          act.avg = cell[j].avg;
+
+
+          plan_summary.inside++;
+
+          if (!decon)
+            {
+              if (params.topo)
+                {
+                  if (cell[j].need && cell[j].value != 0.0) plan_summary.land++;
+                }
+              else
+                {
+                  if (land.isLand (i, j)) plan_summary.land++;
+                }
+            }
+
+
+          //  First case, we have SRTM elevation data loaded in the PFM.  We need to deconflict it with the normal input data
+          //  if the bin has both SRTM and normal data.
+
+          if (decon)
+            {
+              if ((cell[j].validity & PFM_DATA) && binContents (act.coord, decon, &srtm, &valid, &count))
+                {
+                  if (srtm && valid)
+                    {
+                      act.action = MASK_DECON;
+                      plan.append (act);
+
+                      plan_summary.decon++;
+                      plan_summary.decon_records += count;
+                    }
+                  else if (valid && repairBin (&act))
+                    {
+                      act.value = 0.0;
+                      plan.append (act);
+                    }
+                }
+            }
+
+
+          //  Second case, we have already run pfmMask on the file but we (probably) want to change the elevation level of the
+          //  mask value.  We add the mask to empty "land" cells and replace existing mask values where there is no normal input
+          //  data.  If we have a mask index we only look at the depth arrays of bins that have mask records.
+
+          else if (mask_file)
+            {
+              if (cell[j].validity & PFM_DATA)
+                {
+                  if ((!use_index || index.isSet (act.coord.y, act.coord.x)) && binContents (act.coord, mask_file, &srtm, &valid) &&
+                      srtm)
+                    {
+                      if (!use_index) index.set (act.coord.y, act.coord.x);
+
+                      if (!valid)
+                        {
+                          act.action = MASK_REMASK;
+                          act.value = landValue (act.coord, binCenter (act.coord), &stats.srtm_lookups, &stats.srtm_hits);
+                          plan.append (act);
+
+                          plan_summary.remask++;
+                        }
+                    }
+                }
+              else if (act.value != 0.0)
+                {
+                  if (repairBin (&act))
+                    {
+                      plan.append (act);
+                    }
+                  else
+                    {
+                      act.action = MASK_FILL;
+                      plan.append (act);
+
+                      plan_summary.fill++;
+                    }
+
+                  index.set (act.coord.y, act.coord.x);
+                }
+            }
+
+
+          //  Final case, neither SRTM elevations or previous masks were in the PFM so we just want to mask the land.  Only put
+          //  mask points in bins without any valid data.
+
+          else
+            {
+              if (!(cell[j].validity & PFM_DATA) && act.value != 0.0)
+                {
+                  if (repairBin (&act))
+                    {
+                      plan.append (act);
+                    }
+                  else
+                    {
+                      act.action = MASK_FILL;
+                      plan.append (act);
+
+                      plan_summary.fill++;
+                    }
+
+                  index.set (act.coord.y, act.coord.x);
+                }
+
+
+              //  The interrupted run may have added a mask record to a land bin (so it has data now) and not recomputed it.
+              //  Fills only go in land bins so we don't have to look at the others (we don't know the land value of a
+              //  populated bin in topo mode so we have to look at all of them).
+
+              else if ((cell[j].validity & PFM_DATA) && (params.topo || land.isLand (i, j)) && repairBin (&act))
+                {
+                  plan.append (act);
+                  index.set (act.coord.y, act.coord.x);
+                }
+            }
+        }
+    }
+}
+
+
+
+//  Apply pass.  This is the only place (other than opening and closing) that we write to the PFM.  If we can't write the undo
+//  journal we stop before changing the bins that we couldn't journal, recompute the ones that we've already changed, and
+//  return -1 (see error_string).  The progress record isn't updated so the run can be resumed or rolled back.
+
+int32_t 
+maskEngine::applyPlan ()
+{
+  int32_t result = 0, journal_errno = 0;
+
+
+  if (plan.isEmpty ()) return (0);
+
+
+  emit phase (tr ("Applying changes"), plan.size (), PHASE_CHANGES);
+
+  if (params.verbose)
+    {
+      fprintf (stderr, "Applying %d changes\n", plan.size ());
+      fflush (stderr);
+    }
+
+  old_percent = -1;
+  last_progress = 0;
+
+
+  QElapsedTimer apply_timer;
+  apply_timer.start ();
+
+  for (int32_t i = 0 ; i < plan.size () && !result ; )
+    {
+      switch (plan[i].action)
+        {
+          //  Deconflicted and re-masked bins are also done in blocks so that we can journal (and sync) each block before we
+          //  change anything in it.
+
+        case MASK_DECON:
+        case MASK_REMASK:
+          {
+            int32_t end = i + 1;
+
+            while (end < plan.size () && end - i < FILL_BATCH && plan[end].action == plan[i].action) end++;
+
+            if (params.journal && !journalBins (i, end))
+              {
+                journal_errno = errno;
+                result = -1;
+                break;
+              }
+
+            for ( ; i < end ; i++)
+              {
+                if (plan[i].action == MASK_DECON)
+                  {
+                    deconBin (plan[i].coord);
+                  }
+                else
+                  {
+                    remaskBin (plan[i].coord, plan[i].value);
+                  }
+              }
+          }
+          break;
+
+        case MASK_REPAIR:
+          if (plan[i].value != 0.0)
+            {
+              updateBin (plan[i].coord, plan[i].value);
+            }
+          else
+            {
+              markDirty (plan[i].coord);
+            }
+          i++;
+          break;
+
+
+          //  Fills are done in batches of consecutive (in bin order) actions.
+
+        case MASK_FILL:
+          {
+            int32_t end = i + 1;
+
+            while (end < plan.size () && end - i < FILL_BATCH && plan[end].action == MASK_FILL) end++;
+
+            if (!fillBins (i, end))
+              {
+                journal_errno = errno;
+                result = -1;
+                break;
+              }
+
+            i = end;
+          }
+          break;
+        }
+
+
+      if (apply_timer.elapsed () - last_progress >= PROGRESS_INTERVAL)
+        {
+          last_progress = apply_timer.elapsed ();
+          emit progress (i, (double) i * 1000.0 / (double) (last_progress ? last_progress : 1));
+        }
+    }
+
+  plan.clear ();
+
+  stats.apply_time += (double) apply_timer.nsecsElapsed () * 1.0e-9;
+
+
+  recomputeDirty ();
+
+
+  if (params.journal && !journal.sync () && !result)
+    {
+      journal_errno = errno;
+      result = -1;
+    }
+
+  if (result) error_string = tr ("Unable to write to the journal file %1 : %2").arg
+                (QDir::toNativeSeparators (maskJournal::journalName (params.pfm_file))).arg (strerror (journal_errno));
+
+  return (result);
+}
+
+
+
+//  Compute the position of the center of a bin.
+
+NV_F64_COORD2 
+maskEngine::binCenter (NV_I32_COORD2 coord)
+{
+  NV_F64_COORD2 nxy;
+
+  nxy.x = open_args.head.mbr.min_x + (double) coord.x * open_args.head.x_bin_size_degrees + open_args.head.x_bin_size_degrees / 2.0;
+  nxy.y = open_args.head.mbr.min_y + (double) coord.y * open_args.head.y_bin_size_degrees + open_args.head.y_bin_size_degrees / 2.0;
+
+  return (nxy);
+}
+
+
+
+//  Build the SWBD land bitmap for the whole bin grid in one pass.
+
+void 
+maskEngine::buildLandMask ()
+{
+  emit phase (tr ("Building land mask"), height, PHASE_ROWS);
+
+
+  land.setup (&open_args.head, land_res, swbd, params.land_fraction);
+
+
+  //  If we've already built the land mask for this grid (and the SWBD data hasn't changed) we just read it.
+
+  QString cache_name = landMask::cacheName (params.pfm_file);
+  QString source = swbd->version (land_res);
+
+  land_cached = land.read (cache_name, source);
+
+  if (land_cached)
+    {
+      land.buildPyramid ();
+
+      if (params.verbose)
+        {
+          fprintf (stderr, "Read land mask from %s\n", cache_name.toLatin1 ().constData ());
+          fflush (stderr);
+        }
+
+      return;
+    }
+
+
+  old_percent = -1;
+  timer.start ();
+  last_progress = 0;
+
+  for (int32_t i = 0 ; i < height ; i++)
+    {
+      land.buildRow (i);
+
+      reportProgress (i + 1);
+    }
+
+
+  land.buildPyramid ();
+
+
+  if (!params.dry_run && !land.write (cache_name, source) && params.verbose)
+    {
+      fprintf (stderr, "Unable to write land mask cache file %s\n", cache_name.toLatin1 ().constData ());
+      fflush (stderr);
+    }
+
+
+  if (params.verbose)
+    {
+      fprintf (stderr, "100%% processed    \n");
+      fflush (stderr);
+    }
+}
+
+
+
+//  Get the mask value for a bin.  This is either the SRTM topo elevation (as a depth) at the bin center or the fixed mask value
+//  if the bin is land in the SWBD bitmap.  A return of 0.0 means it's not land.  All SRTM reads go through the cache since the
+//  SRTM reader isn't thread safe.  The SRTM cache is shared by the batch engines so we count our own lookups (in lookups and
+//  hits, which belong to the caller's stripe).
+
+float 
+maskEngine::landValue (NV_I32_COORD2 coord, NV_F64_COORD2 nxy, int64_t *lookups, int64_t *hits)
+{
+  if (params.topo)
+    {
+      uint8_t hit;
+
+      int16_t elev = srtm->elevation (nxy.y, nxy.x, &hit);
+
+      (*lookups)++;
+      if (hit) (*hits)++;
+
+      if (elev && elev > 0 && elev != 32767) return (-((float) elev));
+    }
+  else
+    {
+      if (land.isLand (coord.y, coord.x)) return (mask);
+    }
+
+  return (0.0);
+}
+
+
+
+maskStripe::maskStripe (maskEngine *eng, int32_t stg, int32_t r0, int32_t r1)
+{
+  engine = eng;
+  stage = stg;
+  row0 = r0;
+  row1 = r1;
+}
+
+
+
+void 
+maskStripe::run ()
+{
+  engine->stripe (stage, row0, row1);
+}
+
+
+
+//  Write the before images of everything that deconBin or remaskBin will change in a block of plan entries (plan[start] to
+//  plan[end - 1]) to the journal and sync it.  This has to match what deconBin and remaskBin change.  Returns NVFalse if the
+//  journal couldn't be written.
+
+uint8_t 
+maskEngine::journalBins (int32_t start, int32_t end)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+
+
+  for (int32_t i = start ; i < end ; i++)
+    {
+      uint8_t remask = (plan[i].action == MASK_REMASK);
+
+      if (remask && misp && !journal.bin (plan[i].coord, plan[i].avg)) return (NVFalse);
+
+
+      //  Re-masking with a 0.0 land value doesn't change the records.
+
+      if (remask && plan[i].value == 0.0) continue;
+
+      if (readDepth (plan[i].coord, &dep, &recnum)) continue;
+
+      int32_t file = remask ? mask_file : decon;
+
+      for (int32_t k = 0 ; k < recnum ; k++)
+        {
+          if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)) && dep[k].file_number == file && !journal.depth (&dep[k]))
+            return (NVFalse);
+        }
+    }
+
+  return (journal.sync ());
+}
+
+
+
+//  We had SRTM elevation data and valid normal data in the bin so we need to invalidate the SRTM data.
+
+void 
+maskEngine::deconBin (NV_I32_COORD2 coord)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+
+
+  if (readDepth (coord, &dep, &recnum)) return;
+
+
+  //  Invalidate the SRTM records, moving them to the front of the depth buffer (we don't need the rest) so that we can update
+  //  all of them in one call.
+
+  int32_t count = 0;
+
+  for (int32_t k = 0 ; k < recnum ; k++)
+    {
+      if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)))
+        {
+          if (dep[k].file_number == decon)
+            {
+              dep[k].validity |= PFM_FILTER_INVAL;
+
+              if (count != k) dep[count] = dep[k];
+              count++;
+            }
+        }
+    }
+
+
+  //  Update the depth records.
+
+  if (count)
+    {
+      int32_t errors, status = storage->updateDepthRecords (dep, count, &errors);
+      if (status != SUCCESS)
+        {
+          fprintf (stderr, "Error on depth status update for %d of %d records in bin %d %d.\n", errors, count, coord.x, coord.y);
+          fprintf (stderr, "%s\n", storage->statusString (status).toLatin1 ().constData ());
+          fflush (stderr);
+        }
+
+      stats.records_invalidated += count;
+    }
+
+
+  //  The bin record will be recomputed (once) after we've applied the plan.
+
+  markDirty (coord);
+}
+
+
+
+//  We only had SRTM mask or elevation values in the bin so we replace the depth value.
+
+void 
+maskEngine::remaskBin (NV_I32_COORD2 coord, float land_value)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+
+
+  if (readDepth (coord, &dep, &recnum)) return;
+
+
+  float value = 0.0;
+
+  for (int32_t k = 0 ; k < recnum ; k++)
+    {
+      if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)))
+        {
+          if (dep[k].file_number == mask_file)
+            {
+              dep[k].xyz.z = land_value;
+
+              if (dep[k].xyz.z != 0.0)
+                {
+                  value = dep[k].xyz.z;
+
+                  dep[k].validity = PFM_USER_05 | PFM_MODIFIED;
+
+
+                  //  Update the depth array record.
+
+                  int32_t status = storage->changeDepth (&dep[k]);
+                  if (status != SUCCESS)
+                    {
+                      fprintf (stderr, "Error on depth status update.\n");
+                      fprintf (stderr, "%s\n", storage->statusString (status).toLatin1 ().constData ());
+                      fflush (stderr);
+                    }
+
+                  stats.records_changed++;
+                }
+            }
+        }
+    }
+
+
+  updateBin (coord, value);
+}
+
+
+
+//  Add the mask values at the centers of a batch of empty land bins (plan[start] to plan[end - 1]).  We append all of the
+//  depth records first and then update the bins so that we're not bouncing back and forth between the depth and bin files.
+//  The plan is in bin order so both sets of writes are in bin order.  Returns NVFalse (without changing anything) if the
+//  batch couldn't be journaled.
+
+uint8_t 
+maskEngine::fillBins (int32_t start, int32_t end)
+{
+  DEPTH_RECORD dep;
+
+
+  //  Journal the whole batch (and sync it) before we touch the PFM.
+
+  if (params.journal)
+    {
+      for (int32_t i = start ; i < end ; i++)
+        {
+          if (!journal.added (plan[i].coord, file_count, line_count)) return (NVFalse);
+          if (misp && !journal.bin (plan[i].coord, plan[i].avg)) return (NVFalse);
+        }
+
+      if (!journal.sync ()) return (NVFalse);
+    }
+
+
+  for (int32_t i = start ; i < end ; i++)
+    {
+      NV_F64_COORD2 nxy = binCenter (plan[i].coord);
+
+      dep.xyz.x = nxy.x;
+      dep.xyz.y = nxy.y;
+      dep.xyz.z = plan[i].value;
+      dep.horizontal_error = -999.0;
+      dep.vertical_error = -999.0;
+      dep.coord = plan[i].coord;
+
+      dep.validity = PFM_USER_05 | PFM_MODIFIED;
+      dep.beam_number = 0;
+      dep.ping_number = 0;
+      dep.line_number = line_count;
+      dep.file_number = file_count;
+
+
+      //  Add the mask value at the center of the bin as a depth record.
+
+      int32_t status = storage->addDepth (&dep);
+
+      if (status) storage->errorExit (status);
+
+      stats.records_added++;
+    }
+
+
+  add_file = NVTrue;
+
+
+  for (int32_t i = start ; i < end ; i++) updateBin (plan[i].coord, plan[i].value);
+
+  return (NVTrue);
+}
+
+
+
+//  Update a bin record after we've changed its depth records.
+
+void 
+maskEngine::updateBin (NV_I32_COORD2 coord, float value)
+{
+  BIN_RECORD bin;
+
+
+  //  If this was a MISP or GMT surface we have to manually replace the average surface with the mask value.  Filled and
+  //  re-masked bins are only changed once per run so we let the library recompute the bin right away (which leaves us the
+  //  new bin record), replace the average surface in memory, and write it once.  The PFM library doesn't recompute MISP or
+  //  GMT average surfaces and the rest of the bin record comes from the depth array so this is the same bin record that
+  //  we'd get by re-reading it, replacing the average surface, writing it, and recomputing it (--benchmark --bench-misp
+  //  --verify checks that).
+
+  if (misp && !misp_recompute)
+    {
+      storage->recomputeBin (coord, &bin);
+
+      bin.avg_filtered_depth = value;
+
+      storage->writeBin (&bin);
+
+      stats.recomputes++;
+      stats.bin_record_writes++;
+
+      return;
+    }
+
+
+  //  The old way.  We have to re-read the bin record because adding or changing depth records changed the bin record.
+
+  if (misp)
+    {
+      storage->readBin (coord, &bin);
+
+      bin.avg_filtered_depth = value;
+
+      storage->writeBin (&bin);
+
+      stats.bin_record_reads++;
+      stats.bin_record_writes++;
+    }
+
+
+  //  The bin record will be recomputed (once) after we've applied the plan.
+
+  markDirty (coord);
+}
+
+
+
+//  Allocate (and clear) the dirty bin bitmap.
+
+void 
+maskEngine::setupDirty ()
+{
+  dirty_row_bytes = (width + 7) / 8;
+  dirty.fill (0, dirty_row_bytes * height);
+  dirty_count = 0;
+  dirty_row0 = height;
+  dirty_row1 = -1;
+}
+
+
+
+//  Mark a bin as needing to be recomputed.
+
+void 
+maskEngine::markDirty (NV_I32_COORD2 coord)
+{
+  uint8_t *byte = &dirty[coord.y * dirty_row_bytes + (coord.x >> 3)];
+  uint8_t bit = 1 << (coord.x & 7);
+
+  if (*byte & bit) return;
+
+  *byte |= bit;
+  dirty_count++;
+
+  dirty_row0 = qMin (dirty_row0, coord.y);
+  dirty_row1 = qMax (dirty_row1, coord.y);
+}
+
+
+
+//  Recompute the bin records of all of the bins that we changed, once per bin and in bin order.
+
+void 
+maskEngine::recomputeDirty ()
+{
+  BIN_RECORD    bin;
+  NV_I32_COORD2 coord;
+
+
+  if (!dirty_count) return;
+
+
+  emit phase (tr ("Recomputing bins"), dirty_row1 - dirty_row0 + 1, PHASE_ROWS);
+
+  last_progress = 0;
+
+  QElapsedTimer recompute_timer;
+  recompute_timer.start ();
+
+  int64_t done = 0;
+
+  for (coord.y = dirty_row0 ; coord.y <= dirty_row1 ; coord.y++)
+    {
+      uint8_t *row = &dirty[coord.y * dirty_row_bytes];
+
+      for (int32_t k = 0 ; k < dirty_row_bytes ; k++)
+        {
+          if (!row[k]) continue;
+
+          for (int32_t b = 0 ; b < 8 ; b++)
+            {
+              if (row[k] & (1 << b))
+                {
+                  coord.x = k * 8 + b;
+
+
+                  //  Recompute the bin record based on the modified contents of the depth array.
+
+                  storage->recomputeBin (coord, &bin);
+                  done++;
+                  stats.recomputes++;
+                }
+            }
+
+          row[k] = 0;
+        }
+
+
+      if (recompute_timer.elapsed () - last_progress >= PROGRESS_INTERVAL)
+        {
+          last_progress = recompute_timer.elapsed ();
+          emit progress (coord.y - dirty_row0 + 1, (double) done * 1000.0 / (double) (last_progress ? last_progress : 1));
+        }
+    }
+
+
+  dirty_count = 0;
+  dirty_row0 = height;
+  dirty_row1 = -1;
+
+  stats.recompute_time += (double) recompute_timer.nsecsElapsed () * 1.0e-9;
+}
+
+
+
+//  Add the SRTM_mask list file (if we added any mask points) and close the PFM.
+
+void 
+maskEngine::closePFM ()
+{
+  if (add_file && !mask_file)
+    {
+      storage->writeLineFile ((char *) "SRTM_mask");
+      storage->writeListFile ((char *) "/SRTM_mask", PFM_NAVO_ASCII_DATA);
+    }
+
+
+  storage->close ();
+
+
+  if (params.journal && !journal.close () && params.verbose)
+    {
+      fprintf (stderr, "Error closing the journal file %s\n", maskJournal::journalName (params.pfm_file).toLatin1 ().constData ());
+      fflush (stderr);
+    }
+}
+
+
+
+QString 
+maskEngine::reportName (QString pfm_file)
+{
+  return (pfm_file + ".mask_report.json");
+}
+
+
+
+//  Quote a string for the JSON run report.
+
+static QString 
+jsonString (QString string)
+{
+  QString quoted = "\"";
+
+  for (int32_t i = 0 ; i < string.length () ; i++)
+    {
+      QChar c = string.at (i);
+
+      if (c == QChar ('"') || c == QChar ('\\'))
+        {
+          quoted += QChar ('\\');
+          quoted += c;
+        }
+      else if (c.unicode () < 0x20)
+        {
+          quoted += QString ("\\u%1").arg ((int32_t) c.unicode (), 4, 16, QChar ('0'));
+        }
+      else
+        {
+          quoted += c;
+        }
+    }
+
+  quoted += QChar ('"');
+
+  return (quoted);
+}
+
+
+
+//  Write the counters and phase timers for the run to PFM_FILE.mask_report.json so that job monitoring (or a person) can see
+//  where the time went without running a profiler.
+
+void 
+maskEngine::writeReport (int32_t status)
+{
+  QString mode, json;
+
+
+  if (decon)
+    {
+      mode = "deconflict";
+    }
+  else if (mask_file)
+    {
+      mode = "remask";
+    }
+  else
+    {
+      mode = "mask";
+    }
+
+
+  double swbd_rate = stats.swbd_lookups ? (double) stats.swbd_hits / (double) stats.swbd_lookups : 0.0;
+  double srtm_rate = stats.srtm_lookups ? (double) stats.srtm_hits / (double) stats.srtm_lookups : 0.0;
+
+
+  json = "{\n";
+  json += QString ("  \"pfm_file\": %1,\n").arg (jsonString (params.pfm_file));
+  json += QString ("  \"status\": %1,\n").arg (status);
+  json += QString ("  \"error\": %1,\n").arg (jsonString (error_string));
+  json += QString ("  \"mode\": \"%1\",\n").arg (mode);
+  json += QString ("  \"topo\": %1,\n").arg (params.topo ? "true" : "false");
+  json += QString ("  \"mask\": %1,\n").arg (mask, 0, 'f', 3);
+  json += QString ("  \"threads\": %1,\n").arg (params.threads);
+  if (!params.topo) json += QString ("  \"land_resolution\": %1,\n").arg (land_res);
+  if (!params.topo) json += QString ("  \"land_fraction\": %1,\n").arg (params.land_fraction, 0, 'f', 3);
+  if (!params.topo) json += QString ("  \"land_mask_cached\": %1,\n").arg (land_cached ? "true" : "false");
+  json += QString ("  \"resumed\": %1,\n").arg (params.resume ? "true" : "false");
+  json += QString ("  \"bin_width\": %1,\n").arg (width);
+  json += QString ("  \"bin_height\": %1,\n").arg (height);
+
+  json += "  \"counters\": {\n";
+  json += QString ("    \"bins_visited\": %1,\n").arg ((qlonglong) stats.bins_visited);
+  json += QString ("    \"bins_inside\": %1,\n").arg ((qlonglong) stats.bins_inside);
+  json += QString ("    \"bins_filled\": %1,\n").arg ((qlonglong) plan_summary.fill);
+  json += QString ("    \"bins_remasked\": %1,\n").arg ((qlonglong) plan_summary.remask);
+  json += QString ("    \"bins_deconflicted\": %1,\n").arg ((qlonglong) plan_summary.decon);
+  json += QString ("    \"bins_repaired\": %1,\n").arg ((qlonglong) plan_summary.repair);
+  json += QString ("    \"bin_row_reads\": %1,\n").arg ((qlonglong) stats.bin_row_reads);
+  json += QString ("    \"bins_read\": %1,\n").arg ((qlonglong) stats.bins_read);
+  json += QString ("    \"bin_record_reads\": %1,\n").arg ((qlonglong) stats.bin_record_reads);
+  json += QString ("    \"bin_record_writes\": %1,\n").arg ((qlonglong) stats.bin_record_writes);
+  json += QString ("    \"depth_array_reads\": %1,\n").arg ((qlonglong) stats.depth_reads);
+  json += QString ("    \"depth_records_read\": %1,\n").arg ((qlonglong) stats.depth_records_read);
+  json += QString ("    \"swbd_lookups\": %1,\n").arg ((qlonglong) stats.swbd_lookups);
+  json += QString ("    \"swbd_cache_hit_rate\": %1,\n").arg (swbd_rate, 0, 'f', 4);
+  json += QString ("    \"srtm_lookups\": %1,\n").arg ((qlonglong) stats.srtm_lookups);
+  json += QString ("    \"srtm_cache_hit_rate\": %1,\n").arg (srtm_rate, 0, 'f', 4);
+  json += QString ("    \"records_added\": %1,\n").arg ((qlonglong) stats.records_added);
+  json += QString ("    \"records_changed\": %1,\n").arg ((qlonglong) stats.records_changed);
+  json += QString ("    \"records_invalidated\": %1,\n").arg ((qlonglong) stats.records_invalidated);
+  json += QString ("    \"recomputes\": %1\n").arg ((qlonglong) stats.recomputes);
+  json += "  },\n";
+
+  json += "  \"seconds\": {\n";
+  json += QString ("    \"open\": %1,\n").arg (stats.open_time, 0, 'f', 3);
+  json += QString ("    \"land_mask\": %1,\n").arg (stats.land_mask_time, 0, 'f', 3);
+  json += QString ("    \"classify\": %1,\n").arg (stats.classify_time, 0, 'f', 3);
+  json += QString ("    \"bin_read\": %1,\n").arg (stats.bin_read_time, 0, 'f', 3);
+  json += QString ("    \"land_values\": %1,\n").arg (stats.land_value_time, 0, 'f', 3);
+  json += QString ("    \"plan\": %1,\n").arg (stats.plan_time, 0, 'f', 3);
+  json += QString ("    \"depth_array_read\": %1,\n").arg (stats.depth_read_time, 0, 'f', 3);
+  json += QString ("    \"apply\": %1,\n").arg (stats.apply_time, 0, 'f', 3);
+  json += QString ("    \"recompute\": %1,\n").arg (stats.recompute_time, 0, 'f', 3);
+  json += QString ("    \"close\": %1,\n").arg (stats.close_time, 0, 'f', 3);
+  json += QString ("    \"total\": %1\n").arg (stats.total_time, 0, 'f', 3);
+  json += "  }\n";
+  json += "}\n";
+
+
+  FILE *fp;
+
+  if ((fp = fopen (reportName (params.pfm_file).toLatin1 (), "w")) == NULL)
+    {
+      if (params.verbose)
+        {
+          fprintf (stderr, "Unable to write the run report %s\n", reportName (params.pfm_file).toLatin1 ().constData ());
+          fflush (stderr);
+        }
+
+      return;
+    }
+
+  fprintf (fp, "%s", json.toUtf8 ().constData ());
+  fclose (fp);
+}
+
+
+
+QString 
+maskEngine::progressName (QString pfm_file)
+{
+  return (pfm_file + ".mask_progress");
+}
+
+
+
+uint8_t 
+maskEngine::readProgress (MASK_PROGRESS *prog)
+{
+  FILE *fp;
+
+
+  if ((fp = fopen (progressName (params.pfm_file).toLatin1 (), "rb")) == NULL) return (NVFalse);
+
+  uint8_t ok = (fread (prog, sizeof (MASK_PROGRESS), 1, fp) == 1 && !strcmp (prog->magic, PROGRESS_MAGIC) &&
+                prog->version == PROGRESS_VERSION);
+
+  fclose (fp);
+
+  return (ok);
+}
+
+
+
+//  Commit our progress.  Everything before row has been planned, applied, and recomputed.  The record is written to a temporary
+//  file, synced, and renamed so that we never leave a partial record behind (on Windows the old record has to be removed
+//  first since rename won't replace it).  Bins after row may have been changed (records added, replaced, or invalidated)
+//  but not recomputed when the run was interrupted, so a resumed run checks every bin that could have been changed for
+//  records from the interrupted run's file and recomputes them (see repairBin).
+
+uint8_t 
+maskEngine::writeProgress (int32_t row)
+{
+  MASK_PROGRESS prog;
+  FILE          *fp;
+
+
+  memset (&prog, 0, sizeof (MASK_PROGRESS));
+  strcpy (prog.magic, PROGRESS_MAGIC);
+  prog.version = PROGRESS_VERSION;
+  prog.row = row;
+  prog.mask = params.mask;
+  prog.topo = params.topo;
+  prog.deconflict = params.deconflict;
+  prog.decon = decon;
+  prog.mask_file = mask_file;
+  prog.file_count = file_count;
+  prog.line_count = line_count;
+  prog.add_file = add_file;
+  prog.land_resolution = land_res;
+  prog.land_fraction = params.land_fraction;
+  prog.journal = params.journal;
+
+
+  QString name = progressName (params.pfm_file);
+  QString tmp_name = name + ".tmp";
+
+  if ((fp = fopen (tmp_name.toLatin1 (), "wb")) == NULL) return (NVFalse);
+
+  uint8_t ok = (fwrite (&prog, sizeof (MASK_PROGRESS), 1, fp) == 1);
+
+#ifdef NVWIN3X
+  if (fflush (fp) || _commit (_fileno (fp))) ok = NVFalse;
+#else
+  if (fflush (fp) || fsync (fileno (fp))) ok = NVFalse;
+#endif
+  if (fclose (fp)) ok = NVFalse;
+
+#ifdef NVWIN3X
+  if (ok) remove (name.toLatin1 ());
+#endif
+
+  if (!ok || rename (tmp_name.toLatin1 (), name.toLatin1 ()))
+    {
+      remove (tmp_name.toLatin1 ());
+
+      if (params.verbose)
+        {
+          fprintf (stderr, "Unable to write progress record %s\n", name.toLatin1 ().constData ());
+          fflush (stderr);
+        }
+
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+}
+
+
+
+//  Undo everything in the journal.  The journal is replayed backwards.  Changed depth records get their before images back and
+//  mask records that we added are marked as deleted (the PFM library can't remove a record from a depth chain).  Then the
+//  changed bins are recomputed (and get their old average surface values back if it was a MISP or GMT surface) and the
+//  PFM_USER_10 flag name from before the first journaled run is put back.  The SRTM_mask list file entry can't be removed
+//  either, but a list file with only deleted records is harmless.
+
+int32_t 
+maskEngine::rollback ()
+{
+  QVector<JOURNAL_ENTRY> entries;
+  QHash<int64_t, float>  avgs;
+  char                   flag_name[JOURNAL_MAX_PAYLOAD];
+  BIN_RECORD             bin;
+
+
+  QMutexLocker lock (&pfm_mutex);
+
+
+  QString name = maskJournal::journalName (params.pfm_file);
+
+  if (!maskJournal::read (name, &entries, flag_name))
+    {
+      error_string = tr ("Unable to read the journal file %1 : %2").arg (QDir::toNativeSeparators (name)).arg (strerror (errno));
+      return (-1);
+    }
+
+
+  emit phase (tr ("Opening PFM file"), 0, PHASE_ROWS);
+
+  strcpy (open_args.list_path, params.pfm_file.toLatin1 ());
+
+  open_args.checkpoint = 0;
+  if (storage->open (&open_args))
+    {
+      error_string = tr ("The file %1 is not a PFM file or there was an error reading the file.  The error message returned was:\n\n%2").arg
+        (QDir::toNativeSeparators (params.pfm_file)).arg (storage->errorString ());
+      return (-1);
+    }
+
+  width = open_args.head.bin_width;
+  height = open_args.head.bin_height;
+
+  setupDirty ();
+
+
+  emit phase (tr ("Rolling back changes"), entries.size (), PHASE_ENTRIES);
+
+  if (params.verbose)
+    {
+      fprintf (stderr, "Rolling back %d journal entries\n", entries.size ());
+      fflush (stderr);
+    }
+
+  misp = NVFalse;
+  last_progress = 0;
+  timer.start ();
+
+  for (int32_t k = entries.size () - 1 ; k >= 0 ; k--)
+    {
+      JOURNAL_ENTRY *entry = &entries[k];
+
+      switch (entry->type)
+        {
+        case JOURNAL_RUN:
+          if (entry->misp) misp = NVTrue;
+          break;
+
+        case JOURNAL_ADD:
+          undoAdd (entry);
+          break;
+
+        case JOURNAL_DEPTH:
+          storage->changeDepth (&entry->dep);
+          markDirty (entry->coord);
+          break;
+
+
+          //  We're going backwards so the earliest value wins.
+
+        case JOURNAL_BIN:
+          avgs.insert ((int64_t) entry->coord.y * width + entry->coord.x, entry->avg);
+          markDirty (entry->coord);
+          break;
+        }
+
+
+      int32_t done = entries.size () - k;
+
+      if (timer.elapsed () - last_progress >= PROGRESS_INTERVAL)
+        {
+          last_progress = timer.elapsed ();
+          emit progress (done, (double) done * 1000.0 / (double) (last_progress ? last_progress : 1));
+        }
+    }
+
+
+  recomputeDirty ();
+
+
+  //  Put the old MISP or GMT average surface values back.
+
+  if (misp)
+    {
+      for (QHash<int64_t, float>::iterator it = avgs.begin () ; it != avgs.end () ; ++it)
+        {
+          NV_I32_COORD2 coord;
+
+          coord.y = it.key () / width;
+          coord.x = it.key () % width;
+
+          storage->readBin (coord, &bin);
+          bin.avg_filtered_depth = it.value ();
+          storage->writeBin (&bin);
+        }
+    }
+
+
+  if (flag_name[0])
+    {
+      strcpy (open_args.head.user_flag_name[9], flag_name);
+      storage->writeHeader (&open_args.head);
+    }
+
+
+  storage->close ();
+
+  dirty.clear ();
+
+
+  //  The journal has been used up and the mask index no longer matches the file.
+
+  remove (name.toLatin1 ());
+  remove (maskIndex::indexName (params.pfm_file).toLatin1 ());
+
+  return (0);
+}
+
+
+
+//  Undo an added mask record by marking it as deleted.
+
+void 
+maskEngine::undoAdd (JOURNAL_ENTRY *entry)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+
+
+  if (readDepth (entry->coord, &dep, &recnum)) return;
+
+
+  for (int32_t k = 0 ; k < recnum ; k++)
+    {
+      if (dep[k].file_number == entry->file_number && dep[k].line_number == entry->line_number && !(dep[k].validity & PFM_DELETED))
+        {
+          dep[k].validity |= PFM_DELETED;
+
+          int32_t status = storage->updateDepth (&dep[k]);
+          if (status != SUCCESS)
+            {
+              fprintf (stderr, "Error on depth status update.\n");
+              fprintf (stderr, "%s\n", storage->statusString (status).toLatin1 ().constData ());
+              fflush (stderr);
+            }
+        }
+    }
+
+
+  markDirty (entry->coord);
+}
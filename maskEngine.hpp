@@ -0,0 +1,262 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef MASKENGINE_H
+#define MASKENGINE_H
+
+#include "pfmMaskDef.hpp"
+#include "landMask.hpp"
+#include "srtmCache.hpp"
+#include "maskIndex.hpp"
+#include "maskJournal.hpp"
+#include "maskStorage.hpp"
+#include "maskStaging.hpp"
+
+
+class maskStripe;
+
+
+/*!
+    The masking engine.  This does all of the work of land masking a PFM file (deconflicting SRTM data,
+    re-masking, or masking empty land bins) without any GUI dependencies so that it can be driven from
+    the wizard or run headless in batch mode.
+*/
+
+class maskEngine : public QObject
+{
+  Q_OBJECT
+
+
+public:
+
+  maskEngine (MASK_PARAMS *par, QObject *parent = 0);
+  ~maskEngine ();
+
+  static uint8_t srtmDataLoaded (QString pfm_file);
+
+  static QString progressName (QString pfm_file);
+
+  static QString reportName (QString pfm_file);
+
+  void setStorage (maskStorage *store);
+
+  void setCaches (srtmCache *topo_cache, swbdCache *land_cache);
+
+  void setMispRecompute (uint8_t recompute);
+
+  int32_t run ();
+
+  int32_t rollback ();
+
+  int64_t checkClassification (BIN_HEADER *head, int64_t *inside);
+
+  QString errorString ();
+
+  MASK_SUMMARY summary ();
+
+  MASK_STATS statistics ();
+
+
+signals:
+
+  void phase (QString title, int range, int units);
+  void progress (int count, double rate);
+  void finished (int status);
+
+
+public slots:
+
+  void slotRun ();
+
+
+protected:
+
+  friend class maskStripe;
+
+  int32_t process ();
+  void addTime (double *total);
+  void writeReport (int32_t status);
+  int32_t openPFM ();
+  void scanListFiles ();
+  void reportProgress (int32_t rows);
+  void runStripes (QThreadPool *pool, int32_t stage, int32_t row0, int32_t row1);
+  void stripe (int32_t stage, int32_t row0, int32_t row1);
+  uint8_t rowCrossings (double y, QVector<double> *cross);
+  int32_t classifyRow (int32_t row, MASK_CELL *cell, QVector<double> *cross);
+  void classifyBin (int32_t row, int32_t col, MASK_CELL *cell, uint8_t inside);
+  void landRow (int32_t row, MASK_CELL *cell, int64_t *lookups, int64_t *hits);
+  void readBins (int32_t row0, int32_t row1);
+  int32_t readDepth (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum);
+  uint8_t repairBin (MASK_ACTION *act);
+  uint8_t binContents (NV_I32_COORD2 coord, int32_t file, uint8_t *srtm, uint8_t *valid, int32_t *count = NULL);
+  void planBins (int32_t row0, int32_t row1);
+  int32_t applyPlan ();
+  NV_F64_COORD2 binCenter (NV_I32_COORD2 coord);
+  void buildLandMask ();
+  float landValue (NV_I32_COORD2 coord, NV_F64_COORD2 nxy, int64_t *lookups, int64_t *hits);
+  uint8_t journalBins (int32_t start, int32_t end);
+  void deconBin (NV_I32_COORD2 coord);
+  void remaskBin (NV_I32_COORD2 coord, float land_value);
+  uint8_t fillBins (int32_t start, int32_t end);
+  void updateBin (NV_I32_COORD2 coord, float value);
+  void undoAdd (JOURNAL_ENTRY *entry);
+  void setupDirty ();
+  void markDirty (NV_I32_COORD2 coord);
+  void recomputeDirty ();
+  void closePFM ();
+  uint8_t readProgress (MASK_PROGRESS *prog);
+  uint8_t writeProgress (int32_t row);
+
+
+
+  MASK_PARAMS      params;
+
+  PFM_OPEN_ARGS    open_args;
+
+  maskStorage      *storage;                //  The PFM (normally through the PFM library)
+
+  uint8_t          own_storage;             //  We created the storage backend
+
+  int32_t          width;
+
+  int32_t          height;
+
+  float            mask;
+
+  uint8_t          misp;
+
+  uint8_t          misp_recompute;          //  Read, replace, write, and recompute MISP/GMT bins (benchmark reference)
+
+  int32_t          decon;
+
+  int32_t          mask_file;
+
+  int32_t          file_count;
+
+  int32_t          line_count;
+
+  uint8_t          add_file;
+
+  QString          error_string;
+
+  QElapsedTimer    timer;
+
+  int64_t          last_progress;
+
+  int32_t          old_percent;
+
+  QVector<MASK_CELL> cells;                 //  Classification results for the current block of rows
+
+  int32_t          block_start;             //  First row of the current block
+
+  QVector<BIN_RECORD> bin_row;              //  Bin records for one row
+
+  QVector<MASK_ACTION> plan;                //  What we're going to do to each bin (in bin file order)
+
+  QVector<uint8_t> dirty;                   //  One bit per bin, set if the bin needs to be recomputed
+
+  int32_t          dirty_row_bytes;
+
+  int64_t          dirty_count;
+
+  int32_t          dirty_row0;              //  First row with a dirty bin
+
+  int32_t          dirty_row1;              //  Last row with a dirty bin
+
+  landMask         land;                    //  SWBD land mask rasterized onto the bin grid
+
+  srtmCache        *srtm;                   //  SRTM topo elevation cache (topo mode only)
+
+  swbdCache        *swbd;                   //  SWBD land mask cache
+
+  uint8_t          own_srtm;                //  We created the SRTM cache (it's not shared)
+
+  uint8_t          own_swbd;                //  We created the SWBD cache (it's not shared)
+
+  int32_t          land_res;                //  SWBD mask resolution in arc seconds
+
+  uint8_t          land_cached;             //  The land mask was read from the sidecar cache
+
+  static QMutex    pfm_mutex;               //  Only one engine at a time can be in the PFM library
+
+  uint8_t          skip_water;              //  Skip all water blocks of the land mask pyramid
+
+  MASK_SUMMARY     plan_summary;            //  Counts from the planning pass
+
+  maskIndex        index;                   //  Bins that have mask records
+
+  uint8_t          use_index;               //  The mask index was read from a previous run
+
+  int32_t          repair_file;             //  File number of the interrupted run's records (--resume, -1 otherwise)
+
+  maskJournal      journal;                 //  Undo journal (if we're not using a checkpoint)
+
+  MASK_STATS       stats;                   //  Counters and phase timers for the run report
+
+  QMutex           stats_mutex;             //  For the counters updated by the stripe threads
+
+  QElapsedTimer    phase_timer;
+
+  DEPTH_BUFFER     depth_buffer;            //  Reused for every depth array that we read
+};
+
+
+
+//  One row stripe of work for the thread pool.
+
+class maskStripe : public QRunnable
+{
+public:
+
+  maskStripe (maskEngine *eng, int32_t stg, int32_t r0, int32_t r1);
+
+  void run ();
+
+
+protected:
+
+  maskEngine       *engine;
+
+  int32_t          stage;
+
+  int32_t          row0;
+
+  int32_t          row1;
+};
+
+#endif
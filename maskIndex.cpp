@@ -0,0 +1,140 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#include "maskIndex.hpp"
+
+
+maskIndex::maskIndex ()
+{
+  width = height = row_bytes = 0;
+}
+
+
+
+maskIndex::~maskIndex ()
+{
+}
+
+
+
+QString 
+maskIndex::indexName (QString pfm_file)
+{
+  return (pfm_file + ".mask_index");
+}
+
+
+
+//  Allocate an empty bitmap for the PFM bin grid.
+
+void 
+maskIndex::setup (BIN_HEADER *head)
+{
+  width = head->bin_width;
+  height = head->bin_height;
+  row_bytes = (width + 7) / 8;
+
+  bits.fill (0, row_bytes * height);
+}
+
+
+
+void 
+maskIndex::clear ()
+{
+  bits.clear ();
+  bits.squeeze ();
+}
+
+
+
+//  Read the index file.  Returns NVFalse (and leaves an empty bitmap) if the file doesn't exist or doesn't match the PFM.
+
+uint8_t 
+maskIndex::read (QString name, BIN_HEADER *head, int32_t mask_file)
+{
+  MASK_INDEX_HEADER hdr;
+  FILE              *fp;
+
+
+  setup (head);
+
+  if ((fp = rleBitmap::open (name, &hdr, sizeof (MASK_INDEX_HEADER))) == NULL) return (NVFalse);
+
+
+  if (strcmp (hdr.magic, MASK_INDEX_MAGIC) || hdr.version != MASK_INDEX_VERSION || hdr.width != width || hdr.height != height ||
+      hdr.mask_file != mask_file || hdr.min_x != head->mbr.min_x || hdr.min_y != head->mbr.min_y ||
+      hdr.x_bin_size_degrees != head->x_bin_size_degrees || hdr.y_bin_size_degrees != head->y_bin_size_degrees)
+    {
+      fclose (fp);
+      return (NVFalse);
+    }
+
+
+  uint8_t ok = rleBitmap::readRows (fp, bits.data (), width, height, hdr.count);
+
+  fclose (fp);
+
+  return (ok);
+}
+
+
+
+//  Write the index file.
+
+uint8_t 
+maskIndex::write (QString name, BIN_HEADER *head, int32_t mask_file, float mask, uint8_t topo)
+{
+  MASK_INDEX_HEADER hdr;
+
+
+  memset (&hdr, 0, sizeof (MASK_INDEX_HEADER));
+  strcpy (hdr.magic, MASK_INDEX_MAGIC);
+  hdr.version = MASK_INDEX_VERSION;
+  hdr.width = width;
+  hdr.height = height;
+  hdr.mask_file = mask_file;
+  hdr.min_x = head->mbr.min_x;
+  hdr.min_y = head->mbr.min_y;
+  hdr.x_bin_size_degrees = head->x_bin_size_degrees;
+  hdr.y_bin_size_degrees = head->y_bin_size_degrees;
+  hdr.mask = mask;
+  hdr.topo = topo;
+  hdr.count = rleBitmap::count (bits.data (), width, height);
+
+  return (rleBitmap::write (name, &hdr, sizeof (MASK_INDEX_HEADER), bits.data (), width, height));
+}
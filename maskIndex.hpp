@@ -0,0 +1,117 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#ifndef MASKINDEX_H
+#define MASKINDEX_H
+
+#include "pfmMaskDef.hpp"
+#include "rleBitmap.hpp"
+
+
+#define         MASK_INDEX_MAGIC    "pfmMask index"
+#define         MASK_INDEX_VERSION  1
+
+
+/*!
+    Sidecar index of the bins that contain pfmMask mask records.  It is written next to the PFM list file (PFM_FILE.mask_index)
+    at the end of each masking run.  When the PFM already has an SRTM_mask list file, a later run uses it to read the depth
+    arrays of only the bins that have mask records instead of every populated bin in the PFM.
+
+    The file is a header (grid geometry, SRTM_mask list file number, mask value, and source) followed by each row of the
+    bitmap, run length encoded as a run count and (start column, length) pairs (see rleBitmap).
+*/
+
+typedef struct
+{
+  char          magic[16];
+  int32_t       version;
+  int32_t       width;
+  int32_t       height;
+  int32_t       mask_file;                  //  List file number of the SRTM_mask file
+  double        min_x;
+  double        min_y;
+  double        x_bin_size_degrees;
+  double        y_bin_size_degrees;
+  float         mask;                       //  Fixed mask value (SWBD source)
+  int32_t       topo;                       //  Source was SRTM topo instead of SWBD
+  int64_t       count;                      //  Number of bins with mask records
+} MASK_INDEX_HEADER;
+
+
+class maskIndex
+{
+public:
+
+  maskIndex ();
+  ~maskIndex ();
+
+  void setup (BIN_HEADER *head);
+  uint8_t read (QString name, BIN_HEADER *head, int32_t mask_file);
+  uint8_t write (QString name, BIN_HEADER *head, int32_t mask_file, float mask, uint8_t topo);
+  void clear ();
+
+  static QString indexName (QString pfm_file);
+
+
+  //  Set the bit for a bin.
+
+  inline void set (int32_t row, int32_t col)
+  {
+    bits[(int64_t) row * row_bytes + (col >> 3)] |= (1 << (col & 7));
+  }
+
+
+  //  Test the bit for a bin.
+
+  inline uint8_t isSet (int32_t row, int32_t col)
+  {
+    return ((bits[(int64_t) row * row_bytes + (col >> 3)] >> (col & 7)) & 1);
+  }
+
+
+protected:
+
+  int32_t          width;
+
+  int32_t          height;
+
+  int32_t          row_bytes;
+
+  QVector<uint8_t> bits;
+};
+
+#endif
@@ -0,0 +1,260 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#include "maskJournal.hpp"
+
+#ifdef NVWIN3X
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+
+maskJournal::maskJournal ()
+{
+  fp = NULL;
+  status = NVTrue;
+}
+
+
+
+maskJournal::~maskJournal ()
+{
+  close ();
+}
+
+
+
+QString 
+maskJournal::journalName (QString pfm_file)
+{
+  return (pfm_file + ".mask_journal");
+}
+
+
+
+//  Open the journal for appending.
+
+uint8_t 
+maskJournal::open (QString name)
+{
+  if ((fp = fopen (name.toLatin1 (), "ab")) == NULL) return (NVFalse);
+
+  status = NVTrue;
+
+  return (NVTrue);
+}
+
+
+
+//  Flush the journal and force it out to the disk.
+
+uint8_t 
+maskJournal::sync ()
+{
+  if (!fp) return (NVFalse);
+
+#ifdef NVWIN3X
+  if (fflush (fp) || _commit (_fileno (fp))) status = NVFalse;
+#else
+  if (fflush (fp) || fsync (fileno (fp))) status = NVFalse;
+#endif
+
+  return (status);
+}
+
+
+
+uint8_t 
+maskJournal::close ()
+{
+  if (!fp) return (status);
+
+  sync ();
+
+  if (fclose (fp)) status = NVFalse;
+  fp = NULL;
+
+  return (status);
+}
+
+
+
+//  Write an entry (type, payload size, and payload).  Nothing is synced here, the caller syncs before it changes the PFM.
+
+uint8_t 
+maskJournal::append (int32_t type, void *payload, int32_t size)
+{
+  int32_t head[2] = {type, size};
+
+  if (fwrite (head, sizeof (head), 1, fp) != 1 || fwrite (payload, size, 1, fp) != 1) status = NVFalse;
+
+  return (status);
+}
+
+
+
+uint8_t 
+maskJournal::run (char *flag_name, uint8_t misp)
+{
+  uint8_t payload[JOURNAL_MAX_PAYLOAD];
+  int32_t flag = misp;
+
+
+  int32_t length = qMin ((int32_t) strlen (flag_name), JOURNAL_MAX_PAYLOAD - (int32_t) sizeof (int32_t) - 1);
+
+  memcpy (payload, &flag, sizeof (int32_t));
+  memcpy (&payload[sizeof (int32_t)], flag_name, length);
+
+  append (JOURNAL_RUN, payload, sizeof (int32_t) + length);
+
+  return (sync ());
+}
+
+
+
+uint8_t 
+maskJournal::added (NV_I32_COORD2 coord, int32_t file_number, int32_t line_number)
+{
+  int32_t payload[4] = {coord.x, coord.y, file_number, line_number};
+
+  return (append (JOURNAL_ADD, payload, sizeof (payload)));
+}
+
+
+
+uint8_t 
+maskJournal::depth (DEPTH_RECORD *dep)
+{
+  return (append (JOURNAL_DEPTH, dep, sizeof (DEPTH_RECORD)));
+}
+
+
+
+uint8_t 
+maskJournal::bin (NV_I32_COORD2 coord, float avg)
+{
+  uint8_t payload[3 * sizeof (int32_t)];
+
+  memcpy (payload, &coord.x, sizeof (int32_t));
+  memcpy (&payload[sizeof (int32_t)], &coord.y, sizeof (int32_t));
+  memcpy (&payload[2 * sizeof (int32_t)], &avg, sizeof (float));
+
+  return (append (JOURNAL_BIN, payload, sizeof (payload)));
+}
+
+
+
+//  Read all of the entries in a journal.  The flag name is the PFM_USER_10 flag name from the first run's JOURNAL_RUN entry
+//  (empty if there isn't one).  It must hold JOURNAL_MAX_PAYLOAD characters.  A partial entry at the end (we died while
+//  writing it) is ignored since the change it describes was never made.
+
+uint8_t 
+maskJournal::read (QString name, QVector<JOURNAL_ENTRY> *entries, char *flag_name)
+{
+  JOURNAL_ENTRY entry;
+  FILE          *jfp;
+  int32_t       head[2];
+  uint8_t       payload[JOURNAL_MAX_PAYLOAD];
+  uint8_t       have_run = NVFalse;
+
+
+  entries->clear ();
+  flag_name[0] = 0;
+
+  if ((jfp = fopen (name.toLatin1 (), "rb")) == NULL) return (NVFalse);
+
+  while (fread (head, sizeof (head), 1, jfp) == 1)
+    {
+      int32_t size = head[1];
+
+      if (size < 0 || size > JOURNAL_MAX_PAYLOAD || (size && fread (payload, size, 1, jfp) != 1)) break;
+
+
+      memset (&entry, 0, sizeof (JOURNAL_ENTRY));
+      entry.type = head[0];
+
+      switch (entry.type)
+        {
+        case JOURNAL_RUN:
+          if (size < (int32_t) sizeof (int32_t)) continue;
+
+          memcpy (&entry.misp, payload, sizeof (int32_t));
+
+          if (!have_run)
+            {
+              memcpy (flag_name, &payload[sizeof (int32_t)], size - sizeof (int32_t));
+              flag_name[size - sizeof (int32_t)] = 0;
+              have_run = NVTrue;
+            }
+          break;
+
+        case JOURNAL_ADD:
+          if (size != 4 * (int32_t) sizeof (int32_t)) continue;
+
+          memcpy (&entry.coord.x, payload, sizeof (int32_t));
+          memcpy (&entry.coord.y, &payload[sizeof (int32_t)], sizeof (int32_t));
+          memcpy (&entry.file_number, &payload[2 * sizeof (int32_t)], sizeof (int32_t));
+          memcpy (&entry.line_number, &payload[3 * sizeof (int32_t)], sizeof (int32_t));
+          break;
+
+        case JOURNAL_DEPTH:
+          if (size != (int32_t) sizeof (DEPTH_RECORD)) continue;
+
+          memcpy (&entry.dep, payload, sizeof (DEPTH_RECORD));
+          entry.coord = entry.dep.coord;
+          break;
+
+        case JOURNAL_BIN:
+          if (size != 3 * (int32_t) sizeof (int32_t)) continue;
+
+          memcpy (&entry.coord.x, payload, sizeof (int32_t));
+          memcpy (&entry.coord.y, &payload[sizeof (int32_t)], sizeof (int32_t));
+          memcpy (&entry.avg, &payload[2 * sizeof (int32_t)], sizeof (float));
+          break;
+
+        default:
+          continue;
+        }
+
+      entries->append (entry);
+    }
+
+  fclose (jfp);
+
+  return (NVTrue);
+}
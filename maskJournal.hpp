@@ -0,0 +1,111 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#ifndef MASKJOURNAL_H
+#define MASKJOURNAL_H
+
+#include "pfmMaskDef.hpp"
+
+
+#define         JOURNAL_RUN         0           //  Start of a run (MISP flag and before image of the PFM_USER_10 flag name)
+#define         JOURNAL_ADD         1           //  Mask record added to a bin
+#define         JOURNAL_DEPTH       2           //  Before image of a depth record that we changed
+#define         JOURNAL_BIN         3           //  Before image of the average surface of a bin that we changed
+
+
+/*!
+    Write-ahead undo journal.  When journaling is used instead of a PFM checkpoint, the before image of everything that a
+    masking run is about to change is appended to PFM_FILE.mask_journal before it is changed.  The journal is synced to
+    disk before each block of changes is applied.  A rollback replays the journal backwards.  Journals from successive runs
+    are appended so a rollback takes the file back to the state it was in before the first journaled run.
+
+    In the file each entry is its type and payload size (two int32_t's) followed by the payload :
+        - JOURNAL_RUN : misp flag (int32_t) and the PFM_USER_10 flag name (no terminating null)
+        - JOURNAL_ADD : bin index, list file number, and line number of the added record
+        - JOURNAL_DEPTH : the DEPTH_RECORD (it has its own bin index)
+        - JOURNAL_BIN : bin index and average surface value
+*/
+
+#define         JOURNAL_MAX_PAYLOAD 1024        //  Larger than any journal entry payload
+
+
+//  A journal entry as returned by read.
+
+typedef struct
+{
+  int32_t       type;                       //  JOURNAL_RUN, JOURNAL_ADD, JOURNAL_DEPTH, or JOURNAL_BIN
+  NV_I32_COORD2 coord;                      //  Bin index
+  float         avg;                        //  Average surface value (JOURNAL_BIN)
+  int32_t       misp;                       //  The average surface is a MISP or GMT surface (JOURNAL_RUN)
+  int32_t       file_number;                //  List file number of the added record (JOURNAL_ADD)
+  int32_t       line_number;                //  Line number of the added record (JOURNAL_ADD)
+  DEPTH_RECORD  dep;                        //  Depth record (JOURNAL_DEPTH)
+} JOURNAL_ENTRY;
+
+
+class maskJournal
+{
+public:
+
+  maskJournal ();
+  ~maskJournal ();
+
+  uint8_t open (QString name);
+  uint8_t sync ();
+  uint8_t close ();
+
+  uint8_t run (char *flag_name, uint8_t misp);
+  uint8_t added (NV_I32_COORD2 coord, int32_t file_number, int32_t line_number);
+  uint8_t depth (DEPTH_RECORD *dep);
+  uint8_t bin (NV_I32_COORD2 coord, float avg);
+
+  static QString journalName (QString pfm_file);
+  static uint8_t read (QString name, QVector<JOURNAL_ENTRY> *entries, char *flag_name);
+
+
+protected:
+
+  FILE             *fp;
+
+
+  uint8_t          status;                  //  NVFalse if any write has failed
+
+
+  uint8_t append (int32_t type, void *payload, int32_t size);
+};
+
+#endif
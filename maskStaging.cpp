@@ -0,0 +1,630 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "maskStaging.hpp"
+
+#include <algorithm>
+
+
+stagingStorage::stagingStorage (maskStorage *store, int32_t megabytes, uint8_t own)
+{
+  backend = store;
+  own_backend = own;
+  limit = (int64_t) megabytes * 1024 * 1024;
+  staged = NVFalse;
+  width = height = 0;
+  misp = NVFalse;
+  depth_records = max_depth_records = 0;
+}
+
+
+
+stagingStorage::~stagingStorage ()
+{
+  close ();
+  if (own_backend) delete backend;
+}
+
+
+
+uint8_t 
+stagingStorage::isStaged ()
+{
+  return (staged);
+}
+
+
+
+//  Open the PFM and read the whole bin grid.  Whatever is left of the memory limit after the bin grid (but not less than
+//  STAGE_MIN_DEPTH megabytes) is used for the depth record cache.
+
+int32_t 
+stagingStorage::open (PFM_OPEN_ARGS *open_args)
+{
+  if (backend->open (open_args)) return (-1);
+
+
+  width = open_args->head.bin_width;
+  height = open_args->head.bin_height;
+
+  misp = (strstr (open_args->head.average_filt_name, "MINIMUM MISP") || strstr (open_args->head.average_filt_name, "AVERAGE MISP") ||
+          strstr (open_args->head.average_filt_name, "MAXIMUM MISP") || strstr (open_args->head.average_filt_name, "MINIMUM GMT") ||
+          strstr (open_args->head.average_filt_name, "AVERAGE GMT") || strstr (open_args->head.average_filt_name, "MAXIMUM GMT"));
+
+  int64_t grid_bytes = (int64_t) width * height * sizeof (BIN_RECORD);
+
+  staged = (grid_bytes <= limit);
+
+  if (!staged) return (0);
+
+
+  max_depth_records = qMax (limit - grid_bytes, (int64_t) STAGE_MIN_DEPTH * 1024 * 1024) / sizeof (DEPTH_RECORD);
+
+
+  bins.resize ((int64_t) width * height);
+
+  backend->readAhead (0, height);
+
+  for (int32_t i = 0 ; i < height ; i++)
+    {
+      int32_t status = backend->readBinRow (width, i, 0, &bins[(int64_t) i * width]);
+
+      if (status != SUCCESS)
+        {
+          backend->close ();
+          bins.clear ();
+          staged = NVFalse;
+
+          return (-1);
+        }
+    }
+
+  return (0);
+}
+
+
+
+void 
+stagingStorage::close ()
+{
+  if (staged)
+    {
+      flush ();
+
+      bins.clear ();
+      bins.squeeze ();
+      staged = NVFalse;
+    }
+
+  backend->close ();
+}
+
+
+
+//  Order depth record changes by their position in the depth file.
+
+static bool 
+changeLess (const STAGE_CHANGE &a, const STAGE_CHANGE &b)
+{
+  if (a.dep.address.block != b.dep.address.block) return (a.dep.address.block < b.dep.address.block);
+
+  return (a.dep.address.record < b.dep.address.record);
+}
+
+
+
+//  Write everything that we've staged back to the PFM.  Returns SUCCESS or the status of the last write that failed (after
+//  trying all of the rest).
+
+int32_t 
+stagingStorage::flush ()
+{
+  int32_t result = SUCCESS, status;
+
+
+  if (!staged) return (SUCCESS);
+
+
+  //  Changes to existing depth records, in file order.  A stable sort keeps multiple changes to the same record in the order
+  //  that they were made.
+
+  std::stable_sort (changes.begin (), changes.end (), changeLess);
+
+  for (int32_t i = 0 ; i < changes.size () ; i++)
+    {
+      if (changes[i].update)
+        {
+          status = backend->updateDepth (&changes[i].dep);
+        }
+      else
+        {
+          status = backend->changeDepth (&changes[i].dep);
+        }
+
+      if (status != SUCCESS)
+        {
+          fprintf (stderr, "Error on depth status update.\n");
+          fprintf (stderr, "%s\n", backend->statusString (status).toLatin1 ().constData ());
+          fflush (stderr);
+          result = status;
+        }
+    }
+
+  changes.clear ();
+
+
+  //  New depth records.  The engine adds them in bin order.
+
+  for (int32_t i = 0 ; i < adds.size () ; i++)
+    {
+      status = backend->addDepth (&adds[i]);
+
+      if (status != SUCCESS)
+        {
+          fprintf (stderr, "Error adding depth record.\n");
+          fprintf (stderr, "%s\n", backend->statusString (status).toLatin1 ().constData ());
+          fflush (stderr);
+          result = status;
+        }
+    }
+
+  adds.clear ();
+
+
+  //  Recompute and/or write the bins that we touched, in bin order.  If a bin was recomputed and also written (the engine
+  //  sets the average surface of MISP and GMT surfaces) we let the PFM library recompute it and then put our average
+  //  surface back since the library doesn't recompute it for those surfaces.
+
+  QList<int64_t> keys = touched.keys ();
+
+  std::sort (keys.begin (), keys.end ());
+
+  for (int32_t i = 0 ; i < keys.size () ; i++)
+    {
+      uint8_t flags = touched.value (keys[i]);
+      NV_I32_COORD2 coord;
+      BIN_RECORD bin;
+
+      coord.y = keys[i] / width;
+      coord.x = keys[i] % width;
+
+      if (flags & STAGE_RECOMPUTE)
+        {
+          status = backend->recomputeBin (coord, &bin);
+
+          if (status == SUCCESS && misp && (flags & STAGE_WRITE))
+            {
+              bin.avg_filtered_depth = bins[keys[i]].avg_filtered_depth;
+              status = backend->writeBin (&bin);
+            }
+
+          if (status == SUCCESS) bins[keys[i]] = bin;
+        }
+      else
+        {
+          status = backend->writeBin (&bins[keys[i]]);
+        }
+
+      if (status != SUCCESS)
+        {
+          fprintf (stderr, "Error updating bin record %d %d.\n", coord.x, coord.y);
+          fprintf (stderr, "%s\n", backend->statusString (status).toLatin1 ().constData ());
+          fflush (stderr);
+          result = status;
+        }
+    }
+
+  touched.clear ();
+
+
+  //  The cached depth arrays have our fake addresses for the new records so we have to read them again.
+
+  depth.clear ();
+  depth_records = 0;
+
+  return (result);
+}
+
+
+
+QString 
+stagingStorage::errorString ()
+{
+  return (backend->errorString ());
+}
+
+
+
+QString 
+stagingStorage::statusString (int32_t status)
+{
+  return (backend->statusString (status));
+}
+
+
+
+void 
+stagingStorage::errorExit (int32_t status)
+{
+  backend->errorExit (status);
+}
+
+
+
+//  The header and the list and line files are small so they go straight through.
+
+int32_t 
+stagingStorage::writeHeader (BIN_HEADER *head)
+{
+  return (backend->writeHeader (head));
+}
+
+
+
+int32_t 
+stagingStorage::listFileCount ()
+{
+  return (backend->listFileCount ());
+}
+
+
+
+int32_t 
+stagingStorage::lineCount ()
+{
+  return (backend->lineCount ());
+}
+
+
+
+int32_t 
+stagingStorage::readListFile (int32_t file, char *name, int16_t *type)
+{
+  return (backend->readListFile (file, name, type));
+}
+
+
+
+int32_t 
+stagingStorage::writeListFile (char *name, int16_t type)
+{
+  return (backend->writeListFile (name, type));
+}
+
+
+
+int32_t 
+stagingStorage::writeLineFile (char *name)
+{
+  return (backend->writeLineFile (name));
+}
+
+
+
+void 
+stagingStorage::readAhead (int32_t row0, int32_t row1)
+{
+  if (!staged) backend->readAhead (row0, row1);
+}
+
+
+
+int32_t 
+stagingStorage::readBinRow (int32_t length, int32_t row, int32_t col, BIN_RECORD *bin)
+{
+  if (!staged) return (backend->readBinRow (length, row, col, bin));
+
+  memcpy (bin, &bins[(int64_t) row * width + col], length * sizeof (BIN_RECORD));
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+stagingStorage::readBin (NV_I32_COORD2 coord, BIN_RECORD *bin)
+{
+  if (!staged) return (backend->readBin (coord, bin));
+
+  *bin = bins[(int64_t) coord.y * width + coord.x];
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+stagingStorage::writeBin (BIN_RECORD *bin)
+{
+  if (!staged) return (backend->writeBin (bin));
+
+  int64_t index = (int64_t) bin->coord.y * width + bin->coord.x;
+
+  bins[index] = *bin;
+  touched[index] |= STAGE_WRITE;
+
+  return (SUCCESS);
+}
+
+
+
+//  The real recompute is done by the PFM library when we flush.  In the meantime we recompute the parts of the staged bin
+//  record that the engine looks at (the sounding count, the data flag, and the depth statistics) from the staged depth
+//  records.  Like the PFM library, the average surface is left alone for MISP and GMT surfaces (the engine replaces it and
+//  writes the bin).
+
+int32_t 
+stagingStorage::recomputeBin (NV_I32_COORD2 coord, BIN_RECORD *bin)
+{
+  if (!staged) return (backend->recomputeBin (coord, bin));
+
+
+  QVector<DEPTH_RECORD> *dep = loadDepth (coord);
+  int64_t index = (int64_t) coord.y * width + coord.x;
+  BIN_RECORD *rec = &bins[index];
+  double sum = 0.0;
+  float min_z = 0.0, max_z = 0.0;
+  int32_t valid = 0;
+
+
+  for (int32_t k = 0 ; k < dep->size () ; k++)
+    {
+      if ((*dep)[k].validity & (PFM_INVAL | PFM_DELETED)) continue;
+
+      float z = (*dep)[k].xyz.z;
+
+      if (!valid || z < min_z) min_z = z;
+      if (!valid || z > max_z) max_z = z;
+
+      sum += z;
+      valid++;
+    }
+
+
+  rec->num_soundings = dep->size ();
+
+  if (valid)
+    {
+      rec->min_depth = rec->min_filtered_depth = min_z;
+      rec->max_depth = rec->max_filtered_depth = max_z;
+      rec->avg_depth = sum / (double) valid;
+      if (!misp) rec->avg_filtered_depth = rec->avg_depth;
+      rec->validity |= PFM_DATA;
+    }
+  else
+    {
+      rec->validity &= ~PFM_DATA;
+    }
+
+
+  //  Keep the write flag if the bin was written, the average surface we were given has to go back to the PFM.
+
+  touched[index] |= STAGE_RECOMPUTE;
+
+  *bin = *rec;
+
+  return (SUCCESS);
+}
+
+
+
+//  Get the staged depth array for a bin, reading it from the PFM if we haven't seen it yet.  If the cache is full we write
+//  out everything we've staged and start over.
+
+QVector<DEPTH_RECORD> *
+stagingStorage::loadDepth (NV_I32_COORD2 coord)
+{
+  int64_t index = (int64_t) coord.y * width + coord.x;
+
+
+  if (!depth.contains (index))
+    {
+      if (depth_records >= max_depth_records) flush ();
+
+
+      DEPTH_RECORD *dep;
+      int32_t recnum;
+      QVector<DEPTH_RECORD> array;
+
+      if (!backend->readDepthArray (coord, &dep, &recnum))
+        {
+          array.resize (recnum);
+          memcpy (array.data (), dep, recnum * sizeof (DEPTH_RECORD));
+          free (dep);
+
+          depth_records += recnum;
+        }
+
+      depth.insert (index, array);
+    }
+
+  return (&depth[index]);
+}
+
+
+
+//  Like the PFM library, this returns a malloc'ed copy of the depth records that the caller has to free.
+
+int32_t 
+stagingStorage::readDepthArray (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum)
+{
+  if (!staged) return (backend->readDepthArray (coord, dep, recnum));
+
+
+  QVector<DEPTH_RECORD> *src = loadDepth (coord);
+
+  *recnum = src->size ();
+
+  if (!*recnum) return (-1);
+
+  *dep = (DEPTH_RECORD *) malloc (*recnum * sizeof (DEPTH_RECORD));
+
+  if (*dep == NULL)
+    {
+      perror ("Allocating depth array");
+      exit (-1);
+    }
+
+  memcpy (*dep, src->data (), *recnum * sizeof (DEPTH_RECORD));
+
+  return (SUCCESS);
+}
+
+
+
+//  Apply a depth record update or change to the staged depth array and queue it for writing.  New records (that we haven't
+//  written yet) have a negative block address that points back into the adds list so we just change them in place.
+
+void 
+stagingStorage::stageDepth (DEPTH_RECORD *dep, uint8_t update)
+{
+  QVector<DEPTH_RECORD> *array = loadDepth (dep->coord);
+
+
+  for (int32_t k = 0 ; k < array->size () ; k++)
+    {
+      DEPTH_RECORD *rec = &(*array)[k];
+
+      if (rec->address.block == dep->address.block && rec->address.record == dep->address.record)
+        {
+          if (update)
+            {
+              rec->validity = dep->validity;
+            }
+          else
+            {
+              *rec = *dep;
+            }
+
+          break;
+        }
+    }
+
+
+  if (dep->address.block < 0)
+    {
+      DEPTH_RECORD *rec = &adds[-dep->address.block - 1];
+
+      if (update)
+        {
+          rec->validity = dep->validity;
+        }
+      else
+        {
+          *rec = *dep;
+        }
+
+      return;
+    }
+
+
+  STAGE_CHANGE change;
+
+  change.dep = *dep;
+  change.update = update;
+
+  changes.append (change);
+}
+
+
+
+int32_t 
+stagingStorage::readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer)
+{
+  if (!staged) return (backend->readDepthBuffer (coord, buffer));
+
+
+  QVector<DEPTH_RECORD> *src = loadDepth (coord);
+
+  buffer->count = 0;
+
+  if (src->isEmpty ()) return (-1);
+
+  growBuffer (buffer, src->size ());
+
+  memcpy (buffer->dep, src->data (), src->size () * sizeof (DEPTH_RECORD));
+  buffer->count = src->size ();
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+stagingStorage::updateDepth (DEPTH_RECORD *dep)
+{
+  if (!staged) return (backend->updateDepth (dep));
+
+  stageDepth (dep, NVTrue);
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+stagingStorage::changeDepth (DEPTH_RECORD *dep)
+{
+  if (!staged) return (backend->changeDepth (dep));
+
+  stageDepth (dep, NVFalse);
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+stagingStorage::addDepth (DEPTH_RECORD *dep)
+{
+  if (!staged) return (backend->addDepth (dep));
+
+
+  QVector<DEPTH_RECORD> *array = loadDepth (dep->coord);
+
+  DEPTH_RECORD rec = *dep;
+
+  rec.address.block = -(adds.size () + 1);
+  rec.address.record = 0;
+
+  adds.append (rec);
+  array->append (rec);
+  depth_records++;
+
+  return (SUCCESS);
+}
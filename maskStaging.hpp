@@ -0,0 +1,139 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef MASKSTAGING_H
+#define MASKSTAGING_H
+
+#include "maskStorage.hpp"
+
+
+#define         STAGE_WRITE         1           //  Staged bin record was written
+#define         STAGE_RECOMPUTE     2           //  Staged bin record needs to be recomputed from its depth records
+#define         STAGE_MIN_DEPTH     16          //  Minimum depth record cache size in megabytes
+
+
+//  A depth record update or change waiting to be written back.
+
+typedef struct
+{
+  DEPTH_RECORD       dep;
+  uint8_t            update;                //  Validity only (update_depth_record_index) instead of the whole record
+} STAGE_CHANGE;
+
+
+/*!
+    In memory staging backend.  The whole bin grid is read (a row at a time) when the PFM is opened and the depth arrays are
+    read as the engine asks for them.  All of the engine's reads and writes are done in memory and the changes are written
+    back to the PFM in one pass when the storage is flushed (or closed).  Depth record changes are written in file order,
+    new records are appended in bin order, and the touched bins are recomputed and rewritten in bin order.  If the bin grid
+    doesn't fit in the memory limit this just passes everything through to the backend.  If the depth record cache fills
+    up the staged changes are flushed and the cache is emptied.
+*/
+
+class stagingStorage : public maskStorage
+{
+public:
+
+  stagingStorage (maskStorage *store, int32_t megabytes, uint8_t own = NVTrue);
+  ~stagingStorage ();
+
+  uint8_t isStaged ();
+
+  int32_t open (PFM_OPEN_ARGS *open_args);
+  void close ();
+  int32_t flush ();
+  QString errorString ();
+  QString statusString (int32_t status);
+  void errorExit (int32_t status);
+
+  int32_t writeHeader (BIN_HEADER *head);
+  int32_t listFileCount ();
+  int32_t lineCount ();
+  int32_t readListFile (int32_t file, char *name, int16_t *type);
+  int32_t writeListFile (char *name, int16_t type);
+  int32_t writeLineFile (char *name);
+
+  void readAhead (int32_t row0, int32_t row1);
+  int32_t readBinRow (int32_t length, int32_t row, int32_t col, BIN_RECORD *bin);
+  int32_t readBin (NV_I32_COORD2 coord, BIN_RECORD *bin);
+  int32_t writeBin (BIN_RECORD *bin);
+  int32_t recomputeBin (NV_I32_COORD2 coord, BIN_RECORD *bin);
+
+  int32_t readDepthArray (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum);
+  int32_t readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer);
+  int32_t updateDepth (DEPTH_RECORD *dep);
+  int32_t changeDepth (DEPTH_RECORD *dep);
+  int32_t addDepth (DEPTH_RECORD *dep);
+
+
+protected:
+
+  QVector<DEPTH_RECORD> *loadDepth (NV_I32_COORD2 coord);
+  void stageDepth (DEPTH_RECORD *dep, uint8_t update);
+
+
+  maskStorage      *backend;                //  Where the data really lives
+
+  uint8_t          own_backend;             //  We delete the backend when we're done
+
+  int64_t          limit;                   //  Memory limit in bytes
+
+  uint8_t          staged;                  //  The bin grid fit in memory
+
+  int32_t          width;
+
+  int32_t          height;
+
+  uint8_t          misp;                    //  MISP or GMT average surface (not recomputed by the PFM library)
+
+  QVector<BIN_RECORD> bins;                 //  The whole bin grid
+
+  QHash<int64_t, uint8_t> touched;          //  STAGE_WRITE/STAGE_RECOMPUTE flags for changed bins
+
+  QHash<int64_t, QVector<DEPTH_RECORD> > depth;  //  Depth arrays that we've read (with our changes)
+
+  int64_t          depth_records;           //  Number of depth records in the cache
+
+  int64_t          max_depth_records;
+
+  QVector<STAGE_CHANGE> changes;            //  Depth record updates and changes to be written
+
+  QVector<DEPTH_RECORD> adds;               //  New depth records to be appended
+};
+
+#endif
@@ -0,0 +1,375 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#include "maskStorage.hpp"
+
+#ifndef NVWIN3X
+  #include <fcntl.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+
+//  Make sure that a depth buffer can hold count records.  We at least double the buffer each time so there are only a few
+//  reallocations per run.
+
+void 
+maskStorage::growBuffer (DEPTH_BUFFER *buffer, int32_t count)
+{
+  if (count <= buffer->size) return;
+
+
+  int32_t size = qMax (qMax (count, buffer->size * 2), 64);
+
+  DEPTH_RECORD *dep = (DEPTH_RECORD *) realloc (buffer->dep, size * sizeof (DEPTH_RECORD));
+
+  if (dep == NULL)
+    {
+      perror ("Allocating depth buffer");
+      exit (-1);
+    }
+
+  buffer->dep = dep;
+  buffer->size = size;
+}
+
+
+
+void 
+maskStorage::freeBuffer (DEPTH_BUFFER *buffer)
+{
+  free (buffer->dep);
+
+  buffer->dep = NULL;
+  buffer->count = buffer->size = 0;
+}
+
+
+
+//  Read a bin's depth records into a caller owned buffer.  This default version copies the array from readDepthArray.  The
+//  PFM backend hands over the library's array instead of copying it and the in memory backends fill the buffer directly.
+
+int32_t 
+maskStorage::readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+
+
+  buffer->count = 0;
+
+  int32_t status = readDepthArray (coord, &dep, &recnum);
+
+  if (status) return (status);
+
+
+  growBuffer (buffer, recnum);
+
+  memcpy (buffer->dep, dep, recnum * sizeof (DEPTH_RECORD));
+  buffer->count = recnum;
+
+  free (dep);
+
+  return (SUCCESS);
+}
+
+
+
+//  Update the validity of a batch of depth records (normally all of the records that we changed in one bin, in the order that
+//  they were read from the bin's depth chain).  The PFM library doesn't have a bulk update so by default this updates them one
+//  at a time.  Returns SUCCESS or the status of the last update that failed, with the number of failures in errors.
+
+int32_t 
+maskStorage::updateDepthRecords (DEPTH_RECORD *dep, int32_t count, int32_t *errors)
+{
+  int32_t result = SUCCESS;
+
+
+  *errors = 0;
+
+  for (int32_t k = 0 ; k < count ; k++)
+    {
+      int32_t status = updateDepth (&dep[k]);
+
+      if (status != SUCCESS)
+        {
+          result = status;
+          (*errors)++;
+        }
+    }
+
+  return (result);
+}
+
+
+
+pfmStorage::pfmStorage ()
+{
+  pfm_handle = -1;
+  bin_fd = -1;
+  row_bytes = 0;
+}
+
+
+
+pfmStorage::~pfmStorage ()
+{
+  close ();
+}
+
+
+
+int32_t 
+pfmStorage::open (PFM_OPEN_ARGS *open_args)
+{
+  pfm_handle = open_existing_pfm_file (open_args);
+
+  if (pfm_handle < 0) return (-1);
+
+
+  //  We can't decode the (bit packed) bin file ourselves but we can tell the kernel that we read it in order and which rows
+  //  we're going to want next.  The bin records are stored in row order after the header so the file size divided by the
+  //  number of rows is close enough to find a row.
+
+#ifndef NVWIN3X
+  struct stat st;
+
+  if ((bin_fd = ::open (open_args->bin_path, O_RDONLY)) >= 0 && !fstat (bin_fd, &st) && open_args->head.bin_height > 0)
+    {
+      row_bytes = st.st_size / open_args->head.bin_height;
+
+      posix_fadvise (bin_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+
+  return (0);
+}
+
+
+
+void 
+pfmStorage::close ()
+{
+  if (pfm_handle >= 0) close_pfm_file (pfm_handle);
+  pfm_handle = -1;
+
+#ifndef NVWIN3X
+  if (bin_fd >= 0) ::close (bin_fd);
+#endif
+  bin_fd = -1;
+  row_bytes = 0;
+}
+
+
+
+QString 
+pfmStorage::errorString ()
+{
+  return (QString (pfm_error_str (pfm_error)));
+}
+
+
+
+QString 
+pfmStorage::statusString (int32_t status)
+{
+  return (QString (pfm_error_str (status)));
+}
+
+
+
+void 
+pfmStorage::errorExit (int32_t status)
+{
+  pfm_error_exit (status);
+}
+
+
+
+int32_t 
+pfmStorage::writeHeader (BIN_HEADER *head)
+{
+  return (write_bin_header (pfm_handle, head, NVFalse));
+}
+
+
+
+int32_t 
+pfmStorage::listFileCount ()
+{
+  return (get_next_list_file_number (pfm_handle));
+}
+
+
+
+int32_t 
+pfmStorage::lineCount ()
+{
+  return (get_next_line_number (pfm_handle));
+}
+
+
+
+int32_t 
+pfmStorage::readListFile (int32_t file, char *name, int16_t *type)
+{
+  return (read_list_file (pfm_handle, file, name, type));
+}
+
+
+
+int32_t 
+pfmStorage::writeListFile (char *name, int16_t type)
+{
+  return (write_list_file (pfm_handle, name, type));
+}
+
+
+
+int32_t 
+pfmStorage::writeLineFile (char *name)
+{
+  return (write_line_file (pfm_handle, name));
+}
+
+
+
+//  Ask the kernel to start reading a range of bin rows into the page cache.  We pad the range by a row on each side since the
+//  row size is approximate.
+
+void 
+pfmStorage::readAhead (int32_t row0 __attribute__ ((unused)), int32_t row1 __attribute__ ((unused)))
+{
+#ifndef NVWIN3X
+  if (bin_fd < 0 || !row_bytes || row1 <= row0) return;
+
+  int64_t start = qMax ((int64_t) 0, (int64_t) (row0 - 1) * row_bytes);
+
+  posix_fadvise (bin_fd, start, (int64_t) (row1 + 1) * row_bytes - start, POSIX_FADV_WILLNEED);
+#endif
+}
+
+
+
+int32_t 
+pfmStorage::readBinRow (int32_t length, int32_t row, int32_t col, BIN_RECORD *bin)
+{
+  return (read_bin_row (pfm_handle, length, row, col, bin));
+}
+
+
+
+int32_t 
+pfmStorage::readBin (NV_I32_COORD2 coord, BIN_RECORD *bin)
+{
+  return (read_bin_record_index (pfm_handle, coord, bin));
+}
+
+
+
+int32_t 
+pfmStorage::writeBin (BIN_RECORD *bin)
+{
+  return (write_bin_record_index (pfm_handle, bin));
+}
+
+
+
+int32_t 
+pfmStorage::recomputeBin (NV_I32_COORD2 coord, BIN_RECORD *bin)
+{
+  return (recompute_bin_values_index (pfm_handle, coord, bin, 0));
+}
+
+
+
+int32_t 
+pfmStorage::readDepthArray (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum)
+{
+  return (read_depth_array_index (pfm_handle, coord, dep, recnum));
+}
+
+
+
+//  The library allocates a new array for every read so there's no point in copying it.  We free the previous array and keep
+//  this one in the buffer until the next read (or freeBuffer).
+
+int32_t 
+pfmStorage::readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer)
+{
+  DEPTH_RECORD *dep;
+  int32_t      recnum;
+
+
+  buffer->count = 0;
+
+  int32_t status = read_depth_array_index (pfm_handle, coord, &dep, &recnum);
+
+  if (status) return (status);
+
+
+  free (buffer->dep);
+
+  buffer->dep = dep;
+  buffer->count = buffer->size = recnum;
+
+  return (SUCCESS);
+}
+
+
+
+int32_t 
+pfmStorage::updateDepth (DEPTH_RECORD *dep)
+{
+  return (update_depth_record_index (pfm_handle, dep));
+}
+
+
+
+int32_t 
+pfmStorage::changeDepth (DEPTH_RECORD *dep)
+{
+  return (change_depth_record_index (pfm_handle, dep));
+}
+
+
+
+int32_t 
+pfmStorage::addDepth (DEPTH_RECORD *dep)
+{
+  return (add_depth_record_index (pfm_handle, dep));
+}
@@ -0,0 +1,147 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#ifndef MASKSTORAGE_H
+#define MASKSTORAGE_H
+
+#include "pfmMaskDef.hpp"
+
+
+//  Caller owned depth record buffer for readDepthBuffer.  Backends that copy into it only grow it so, after the first few
+//  bins, reading a depth array doesn't allocate anything.  The PFM backend just puts the library's array in it (and frees
+//  the previous one).  Either way the memory is malloc'ed and is released with freeBuffer.
+
+typedef struct
+{
+  DEPTH_RECORD       *dep;
+  int32_t            count;                 //  Number of records in the buffer
+  int32_t            size;                  //  Number of records allocated
+} DEPTH_BUFFER;
+
+
+/*!
+    Storage interface for the masking engine.  Every read and write that the engine does to the PFM goes through one of these
+    so that the engine can be run against something other than a PFM file on disk (e.g. the synthetic PFM used for
+    benchmarking).  The calls are the same as the PFM library calls that they replace, without the handle.  Status values
+    are PFM library status values (SUCCESS or an error code that can be passed to statusString).  Backends that hold on to
+    changes (like the in memory staging backend) write them out on flush.
+*/
+
+class maskStorage
+{
+public:
+
+  virtual ~maskStorage () {};
+
+  virtual int32_t open (PFM_OPEN_ARGS *open_args) = 0;
+  virtual void close () = 0;
+  virtual int32_t flush () {return (SUCCESS);};
+  virtual QString errorString () = 0;
+  virtual QString statusString (int32_t status) = 0;
+  virtual void errorExit (int32_t status) = 0;
+
+  virtual int32_t writeHeader (BIN_HEADER *head) = 0;
+  virtual int32_t listFileCount () = 0;
+  virtual int32_t lineCount () = 0;
+  virtual int32_t readListFile (int32_t file, char *name, int16_t *type) = 0;
+  virtual int32_t writeListFile (char *name, int16_t type) = 0;
+  virtual int32_t writeLineFile (char *name) = 0;
+
+  virtual void readAhead (int32_t row0 __attribute__ ((unused)), int32_t row1 __attribute__ ((unused))) {};
+  virtual int32_t readBinRow (int32_t length, int32_t row, int32_t col, BIN_RECORD *bin) = 0;
+  virtual int32_t readBin (NV_I32_COORD2 coord, BIN_RECORD *bin) = 0;
+  virtual int32_t writeBin (BIN_RECORD *bin) = 0;
+  virtual int32_t recomputeBin (NV_I32_COORD2 coord, BIN_RECORD *bin) = 0;
+
+  virtual int32_t readDepthArray (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum) = 0;
+  virtual int32_t readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer);
+  virtual int32_t updateDepth (DEPTH_RECORD *dep) = 0;
+  virtual int32_t updateDepthRecords (DEPTH_RECORD *dep, int32_t count, int32_t *errors);
+  virtual int32_t changeDepth (DEPTH_RECORD *dep) = 0;
+  virtual int32_t addDepth (DEPTH_RECORD *dep) = 0;
+
+  static void growBuffer (DEPTH_BUFFER *buffer, int32_t count);
+  static void freeBuffer (DEPTH_BUFFER *buffer);
+};
+
+
+
+//  The real thing.  A PFM file accessed through the PFM library.
+
+class pfmStorage : public maskStorage
+{
+public:
+
+  pfmStorage ();
+  ~pfmStorage ();
+
+  int32_t open (PFM_OPEN_ARGS *open_args);
+  void close ();
+  QString errorString ();
+  QString statusString (int32_t status);
+  void errorExit (int32_t status);
+
+  int32_t writeHeader (BIN_HEADER *head);
+  int32_t listFileCount ();
+  int32_t lineCount ();
+  int32_t readListFile (int32_t file, char *name, int16_t *type);
+  int32_t writeListFile (char *name, int16_t type);
+  int32_t writeLineFile (char *name);
+
+  void readAhead (int32_t row0, int32_t row1);
+  int32_t readBinRow (int32_t length, int32_t row, int32_t col, BIN_RECORD *bin);
+  int32_t readBin (NV_I32_COORD2 coord, BIN_RECORD *bin);
+  int32_t writeBin (BIN_RECORD *bin);
+  int32_t recomputeBin (NV_I32_COORD2 coord, BIN_RECORD *bin);
+
+  int32_t readDepthArray (NV_I32_COORD2 coord, DEPTH_RECORD **dep, int32_t *recnum);
+  int32_t readDepthBuffer (NV_I32_COORD2 coord, DEPTH_BUFFER *buffer);
+  int32_t updateDepth (DEPTH_RECORD *dep);
+  int32_t changeDepth (DEPTH_RECORD *dep);
+  int32_t addDepth (DEPTH_RECORD *dep);
+
+
+protected:
+
+  int32_t          pfm_handle;
+
+  int32_t          bin_fd;                  //  Read only descriptor for the bin file (only used for readahead hints)
+
+  int64_t          row_bytes;               //  Approximate size of a row of bins in the bin file
+};
+
+#endif
@@ -81,7 +81,12 @@ pfmMask::pfmMask (int32_t *argc, char **argv, QWidget *parent)
 
   setPage (0, new startPage (argc, argv, &options, this));
 
-  setPage (1, new runPage (this, &progress, &checkList));
+  run_page = new runPage (this, &progress, &checkList);
+  setPage (1, run_page);
+
+
+  engine = NULL;
+  engine_thread = NULL;
 
 
   setButtonText (QWizard::CustomButton1, tr("&Run"));
@@ -97,6 +102,14 @@ pfmMask::pfmMask (int32_t *argc, char **argv, QWidget *parent)
 
 pfmMask::~pfmMask ()
 {
+  //  Don't pull the rug out from under a running engine.
+
+  if (engine_thread)
+    {
+      engine_thread->wait ();
+      delete engine;
+      delete engine_thread;
+    }
 }
 
 
@@ -199,17 +212,12 @@ void pfmMask::slotHelpClicked ()
 
 
 
-//  This is where the fun stuff happens.
+//  Run the masking engine on the selected file.
 
 void 
 pfmMask::slotCustomButtonClicked (int id __attribute__ ((unused)))
 {
-  int32_t             pfm_handle, width, height;
-  uint8_t             misp = NVFalse;
-  BIN_RECORD          bin;
-  PFM_OPEN_ARGS       open_args;
-  QString             string;
-
+  MASK_PARAMS         params;
 
 
   QApplication::setOverrideCursor (Qt::WaitCursor);
@@ -218,505 +226,82 @@ pfmMask::slotCustomButtonClicked (int id __attribute__ ((unused)))
   button (QWizard::FinishButton)->setEnabled (false);
   button (QWizard::BackButton)->setEnabled (false);
   button (QWizard::CustomButton1)->setEnabled (false);
+  button (QWizard::CancelButton)->setEnabled (false);
 
 
-  strcpy (open_args.list_path, pfm_file_name.toLatin1 ());
-
-
-  progress.mbox->setTitle (tr ("Creating checkpoint file"));
-  progress.mbar->setRange (0, 0);
-  qApp->processEvents ();
-
-
-  //  Check point the file in case we barf.
-
-  open_args.checkpoint = 1;
-  pfm_handle = open_existing_pfm_file (&open_args);
-
-
-  //  We're going to try to use PFM_USER_10 as a landmask tag (assuming it hasn't been used yet).
-
-  if (strcmp (open_args.head.user_flag_name[9], "PFM_USER_10") && strcmp (open_args.head.user_flag_name[9], "Land masked point"))
-    {
-      QMessageBox::critical (this, tr ("pfmMask"), 
-                             tr ("Unable to use PFM_USER_10 flag for land masked data.\nFlag already in use for %1").arg (open_args.head.user_flag_name[9]));
-      exit (-1);
-    }
-
-  strcpy (open_args.head.user_flag_name[9], "Land masked point");
-
-  write_bin_header (pfm_handle, &open_args.head, NVFalse);
-
-
-  width = open_args.head.bin_width;
-  height = open_args.head.bin_height;
-
-
-  //  Check to see if the land mask is available.
-
-  if (options.topo)
-    {
-      //  Just to keep life simple I'm excluding the srtm2 data (DOD restricted).  Since we only use this for 
-      //  large scale areas it shouldn't matter.
-
-      set_exclude_srtm2_data (NVTrue);
-    }
-  else
-    {
-      if (check_swbd_mask (1) != NULL)
-        {
-          QString err = QString (check_swbd_mask (1));
-
-          QMessageBox::critical (this, tr ("pfmMask"), tr ("The SWBD mask is not avalable for the following reason : \n\n") + err);
-
-          exit (-1);
-        }
-    }
-
-
-  //  Check to see if the average surface is a MISP or GMT surface.
-
-  if (strstr (open_args.head.average_filt_name, "MINIMUM MISP") || strstr (open_args.head.average_filt_name, "AVERAGE MISP") ||
-      strstr (open_args.head.average_filt_name, "MAXIMUM MISP") || strstr (open_args.head.average_filt_name, "MINIMUM GMT") ||
-      strstr (open_args.head.average_filt_name, "AVERAGE GMT") || strstr (open_args.head.average_filt_name, "MAXIMUM GMT"))
-    misp = NVTrue;
-
-
-  int32_t decon = 0;
-  int32_t mask_file = 0;
+  params.pfm_file = pfm_file_name;
+  params.topo = options.topo;
+  params.mask = mask;
+  params.deconflict = NVFalse;
+  params.verbose = NVFalse;
+  params.threads = QThread::idealThreadCount ();
+  params.cache_size = SRTM_CACHE_SIZE;
+  params.dry_run = NVFalse;
+  params.journal = NVFalse;
+  params.resume = NVFalse;
+  params.stage_size = 0;
+  params.land_resolution = 0;
+  params.land_fraction = 0.0;
 
 
   //  Check to see if we already have SRTM data in the PFM file.
 
-  int32_t file_count = get_next_list_file_number (pfm_handle);
-  int32_t line_count = get_next_line_number (pfm_handle);
-
-  for (int16_t i = 0 ; i < file_count ; i++)
+  if (maskEngine::srtmDataLoaded (pfm_file_name))
     {
-      char filename[512];
-      int16_t type;
-
-      read_list_file (pfm_handle, i, filename, &type);
-
-
-      if (strstr (filename, "SRTM_mask")) mask_file = i;
-
-
-      if (strstr (filename, "SRTM_data"))
-        {
-          QMessageBox msgBox (this);
-          msgBox.setIcon (QMessageBox::Question);
-          msgBox.setInformativeText (tr ("SRTM data is already loaded in this PFM.  Do you wish to deconflict it with the input data?"));
-          msgBox.setStandardButtons (QMessageBox::Yes | QMessageBox::No);
-          msgBox.setDefaultButton (QMessageBox::Yes);
-          int32_t ret = msgBox.exec ();
-
-          if (ret == QMessageBox::Yes)
-            {
-              decon = i;
-              break;
-            }
-          else
-            {
-              break;
-            }
-        }
-    }
-
-
-  if (mask_file)
-    {
-      decon = 0;
-      file_count = mask_file;
-    }
-
-
-  if (decon)
-    {
-      progress.mbox->setTitle (tr ("Deconflicting SRTM data with input data"));
+      QMessageBox msgBox (this);
+      msgBox.setIcon (QMessageBox::Question);
+      msgBox.setInformativeText (tr ("SRTM data is already loaded in this PFM.  Do you wish to deconflict it with the input data?"));
+      msgBox.setStandardButtons (QMessageBox::Yes | QMessageBox::No);
+      msgBox.setDefaultButton (QMessageBox::Yes);
+      int32_t ret = msgBox.exec ();
+
+      if (ret == QMessageBox::Yes) params.deconflict = NVTrue;
     }
-  else
-    {
-      progress.mbox->setTitle (tr ("Filling land data"));
-    }
-  progress.mbar->setRange (0, height);
-  qApp->processEvents ();
-
-
-  double half_x = open_args.head.x_bin_size_degrees / 2.0, half_y = open_args.head.y_bin_size_degrees / 2.0;
-  uint8_t add_file = NVFalse;
-
-
-  for (int32_t i = 0 ; i < height ; i++)
-    {
-      NV_F64_COORD2 nxy;
-
-
-      nxy.y = open_args.head.mbr.min_y + (double) i * open_args.head.y_bin_size_degrees + half_y;
-
-      for (int32_t j = 0 ; j < width ; j++)
-	{
-          nxy.x = open_args.head.mbr.min_x + (double) j * open_args.head.x_bin_size_degrees + half_x;
-
-
-          //  Don't try to deal with points that fall outside of the PFM polygon (it might not be a rectangle).
-
-          if (bin_inside_ptr (&open_args.head, nxy))
-            {
-              NV_I32_COORD2 coord;
-              compute_index_ptr (nxy, &coord, &open_args.head);
-              read_bin_record_index (pfm_handle, coord, &bin);
-
-
-              int32_t recnum;
-
-
-              //  First case, we have SRTM elevation data loaded in the PFM.  We need to deconflict it with the normal input data.
-
-              if (decon)
-                {
-                  DEPTH_RECORD *dep;
-
-                  if (bin.validity & PFM_DATA)
-                    {
-                      if (!read_depth_array_index (pfm_handle, coord, &dep, &recnum))
-                        {
-                          uint8_t valid = NVFalse, srtm = NVFalse;
-
-                          for (int32_t k = 0 ; k < recnum ; k++)
-                            {
-                              if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)))
-                                {
-                                  if (dep[k].file_number == decon)
-                                    {
-                                      srtm = NVTrue;
-                                      if (valid) break;
-                                    }
-                                  else
-                                    {
-                                      valid = NVTrue;
-                                      if (srtm) break;
-                                    }
-                                }
-                            }
-
-
-                          //  If we had SRTM elevation data and valid normal data we need to invalidate the SRTM data.
-
-                          if (srtm && valid)
-                            {
-                              for (int32_t k = 0 ; k < recnum ; k++)
-                                {
-                                  if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)))
-                                    {
-                                      if (dep[k].file_number == decon)
-                                        {
-                                          dep[k].validity |= PFM_FILTER_INVAL;
-
-
-                                          //  Update the depth record.
-
-                                          int32_t status = update_depth_record_index (pfm_handle, &dep[k]);
-                                          if (status != SUCCESS)
-                                            {
-                                              fprintf (stderr, "Error on depth status update.\n");
-                                              fprintf (stderr, "%s\n", pfm_error_str (status));
-                                              fflush (stderr);
-                                            }
-
-
-                                          //  Recompute the bin record based on the modified contents of the depth array.
-
-                                          recompute_bin_values_index (pfm_handle, coord, &bin, 0);
-                                        }
-                                    }
-                                }
-                            }
-
-                          free (dep);
-                        }
-                    }
-                }
-
-
-              //  Second case, we have already run pfmMask on the file but we (probably) want to change the elevation level of the mask value.
-              //  We add the mask to empty "land" cells and replace existing mask values where there is no normal input data.
-
-              else if (mask_file)
-                {
-                  //  There is data in the cell (may be mask or normal).
-
-                  if (bin.validity & PFM_DATA)
-                    {
-                      DEPTH_RECORD *dep;
-
-                      if (!read_depth_array_index (pfm_handle, coord, &dep, &recnum))
-                        {
-                          uint8_t valid = NVFalse, srtm = NVFalse;
 
-                          for (int32_t k = 0 ; k < recnum ; k++)
-                            {
-                              if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)))
-                                {
-                                  if (dep[k].file_number == mask_file)
-                                    {
-                                      srtm = NVTrue;
-                                      if (valid) break;
-                                    }
-                                  else
-                                    {
-                                      valid = NVTrue;
-                                      if (srtm) break;
-                                    }
-                                }
-                            }
 
+  //  Run the engine in its own thread so the GUI doesn't slow down the masking loop (and vice versa).
 
-                          //  If we only had SRTM mask or elevation values, replace the depth value.
-
-                          if (srtm && !valid)
-                            {
-                              float value = 0.0;
-
-                              for (int32_t k = 0 ; k < recnum ; k++)
-                                {
-                                  if (!(dep[k].validity & (PFM_INVAL | PFM_DELETED)))
-                                    {
-                                      if (dep[k].file_number == mask_file)
-                                        {
-                                          dep[k].xyz.z = 0.0;
-
-                                          if (options.topo)
-                                            {
-                                              int16_t elev = read_srtm_topo (nxy.y, nxy.x);
-                                              if (elev && elev > 0 && elev != 32767) dep[k].xyz.z = -((float) elev);
-                                            }
-                                          else
-                                            {
-                                              if (swbd_is_land (nxy.y, nxy.x, 1)) dep[k].xyz.z = (float) mask;
-                                            }
+  engine = new maskEngine (&params);
+  engine_thread = new QThread;
+  engine->moveToThread (engine_thread);
 
-                                          if (dep[k].xyz.z != 0.0)
-                                            {
-                                              value = dep[k].xyz.z;
-
-                                              dep[k].validity = PFM_USER_05 | PFM_MODIFIED;
-
-
-                                              //  Update the depth array record.
-
-                                              int32_t status = change_depth_record_index (pfm_handle, &dep[k]);
-                                              if (status != SUCCESS)
-                                                {
-                                                  fprintf (stderr, "Error on depth status update.\n");
-                                                  fprintf (stderr, "%s\n", pfm_error_str (status));
-                                                  fflush (stderr);
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-
-
-                              //  If this was a MISP or GMT surface we have to manually replace the average surface with the
-                              //  mask value.
-
-                              if (misp)
-                                {
-                                  //  We have to re-read the bin record because the update_depth_record changed the bin record.
-
-                                  read_bin_record_index (pfm_handle, coord, &bin);
-
-
-                                  bin.avg_filtered_depth = value;
-
-
-                                  //  Write the record back out.
-
-                                  write_bin_record_index (pfm_handle, &bin);
-                                }
-
-
-                              //  Recompute the bin record based on the modified contents of the depth array.
-
-                              recompute_bin_values_index (pfm_handle, coord, &bin, 0);
-                            }
-
-                          free (dep);
-                        }
-                    }
-
-
-                  //  This is an empty cell so we need to mask it if it's land.
-
-                  else
-                    {
-                      DEPTH_RECORD dep;
-
-                      dep.xyz.z = 0.0;
-
-                      if (options.topo)
-                        {
-                          int16_t elev = read_srtm_topo (nxy.y, nxy.x);
-                          if (elev && elev > 0 && elev != 32767) dep.xyz.z = -((float) elev);
-                        }
-                      else
-                        {
-                          if (swbd_is_land (nxy.y, nxy.x, 1)) dep.xyz.z = (float) mask;
-                        }
-
-
-                      if (dep.xyz.z != 0.0)
-                        {
-                          dep.xyz.x = nxy.x;
-                          dep.xyz.y = nxy.y;
-                          dep.horizontal_error = -999.0;
-                          dep.vertical_error = -999.0;
-                          dep.coord = coord;
-
-                          dep.validity = PFM_USER_05 | PFM_MODIFIED;
-                          dep.beam_number = 0;
-                          dep.ping_number = 0;
-                          dep.line_number = line_count;
-                          dep.file_number = file_count;
-
-
-                          //  Add the mask value at the center of the bin as a depth record.
-
-                          int32_t status = add_depth_record_index (pfm_handle, &dep);
-
-                          if (status) pfm_error_exit (status);
-
-
-                          //  If this was a MISP or GMT surface we have to manually replace the average surface with the
-                          //  mask value.
-
-                          if (misp)
-                            {
-                              //  We have to re-read the bin record because the add_depth_record changed the bin record.
-
-                              read_bin_record_index (pfm_handle, coord, &bin);
-
-
-                              bin.avg_filtered_depth = dep.xyz.z;
-
-
-                              //  Write the record back out.
-
-                              write_bin_record_index (pfm_handle, &bin);
-                            }
-
-
-                          //  Recompute the bin record based on the modified contents of the depth array.
-
-                          recompute_bin_values_index (pfm_handle, coord, &bin, 0);
-                        }
-                    }
-                }
-
-
-              //  Final case, neither SRTM elevations or previous masks were in the PFM so we just want to mask the land.
-
-              else
-                {
-                  DEPTH_RECORD dep;
-
-
-                  //  Only put mask points in bins without any valid data.
-
-                  if (!(bin.validity & PFM_DATA))
-                    {
-                      dep.xyz.z = 0.0;
-
-                      if (options.topo)
-                        {
-                          int16_t elev = read_srtm_topo (nxy.y, nxy.x);
-                          if (elev && elev > 0 && elev != 32767) dep.xyz.z = -((float) elev);
-                        }
-                      else
-                        {
-                          if (swbd_is_land (nxy.y, nxy.x, 1)) dep.xyz.z = (float) mask;
-                        }
-
-
-                      if (dep.xyz.z != 0.0)
-                        {
-                          dep.xyz.x = nxy.x;
-                          dep.xyz.y = nxy.y;
-                          dep.horizontal_error = -999.0;
-                          dep.vertical_error = -999.0;
-                          dep.coord = coord;
-
-
-                          dep.validity = PFM_USER_05 | PFM_MODIFIED;
-                          dep.beam_number = 0;
-                          dep.ping_number = 0;
-                          dep.line_number = line_count;
-                          dep.file_number = file_count;
-
-
-                          add_file = NVTrue;
-
-
-                          //  Add the mask value at the center of the bin as a depth record.
-
-                          int32_t status = add_depth_record_index (pfm_handle, &dep);
-
-                          if (status) pfm_error_exit (status);
-
-
-                          //  If this was a MISP or GMT surface we have to manually replace the average surface with the
-                          //  mask value.
-
-                          if (misp)
-                            {
-                              //  We have to re-read the bin record because the add_depth_record changed the bin record.
-
-                              read_bin_record_index (pfm_handle, coord, &bin);
+  connect (engine_thread, SIGNAL (started ()), engine, SLOT (slotRun ()));
+  connect (engine, SIGNAL (phase (QString, int, int)), run_page, SLOT (slotPhase (QString, int, int)), Qt::QueuedConnection);
+  connect (engine, SIGNAL (progress (int, double)), run_page, SLOT (slotProgress (int, double)), Qt::QueuedConnection);
+  connect (engine, SIGNAL (finished (int)), this, SLOT (slotEngineFinished (int)), Qt::QueuedConnection);
 
+  engine_thread->start ();
+}
 
-                              bin.avg_filtered_depth = dep.xyz.z;
 
 
-                              //  Write the record back out.
+void 
+pfmMask::slotEngineFinished (int status)
+{
+  engine_thread->quit ();
+  engine_thread->wait ();
 
-                              write_bin_record_index (pfm_handle, &bin);
-                            }
+  QString error = engine->errorString ();
+  QString report = maskEngine::reportName (pfm_file_name);
 
+  delete engine;
+  engine = NULL;
+  delete engine_thread;
+  engine_thread = NULL;
 
-                          //  Recompute the bin record based on the modified contents of the depth array.
 
-                          recompute_bin_values_index (pfm_handle, coord, &bin, 0);
-                        }
-                    }
-                }
-            }
+  if (status)
+    {
+      QApplication::restoreOverrideCursor ();
 
-          progress.mbar->setValue (i);
-          qApp->processEvents ();
-        }
+      QMessageBox::critical (this, tr ("pfmMask"), error);
+      exit (-1);
     }
 
-  progress.mbar->setValue (height);
-  qApp->processEvents ();
-
-
-  //if (!decon) swbd_is_land (999.0, 999.0, 1);
-
 
   checkList->clear ();
 
 
-  if (add_file && !mask_file)
-    {
-      write_line_file (pfm_handle, (char *) "SRTM_mask");
-      write_list_file (pfm_handle, (char *) "/SRTM_mask", PFM_NAVO_ASCII_DATA);
-    }
-
-
-  close_pfm_file (pfm_handle);
-
-
   button (QWizard::FinishButton)->setEnabled (true);
   button (QWizard::CancelButton)->setEnabled (false);
 
@@ -724,6 +309,8 @@ pfmMask::slotCustomButtonClicked (int id __attribute__ ((unused)))
   QApplication::restoreOverrideCursor ();
 
 
+  checkList->addItem (tr ("Run report : ") + report);
+
   checkList->addItem (" ");
   QListWidgetItem *cur = new QListWidgetItem (tr ("Masking complete, press Finish to exit."));
 
@@ -42,6 +42,7 @@
 #include "pfmMaskDef.hpp"
 #include "startPage.hpp"
 #include "runPage.hpp"
+#include "maskEngine.hpp"
 
 
 class pfmMask : public QWizard
@@ -71,6 +72,12 @@ protected:
 
   QListWidget      *checkList;
 
+  runPage          *run_page;
+
+  maskEngine       *engine;
+
+  QThread          *engine_thread;
+
   QString          pfm_file_name;
 
   float            mask;
@@ -80,6 +87,7 @@ protected slots:
 
   void slotHelpClicked ();
   void slotCustomButtonClicked (int id);
+  void slotEngineFinished (int status);
 
 };
 
@@ -17,12 +17,24 @@ DEPENDPATH += .
 INCLUDEPATH += .
 
 # Input
-HEADERS += pfmMask.hpp \
+HEADERS += blockCache.hpp \
+           landMask.hpp \
+           maskBatch.hpp \
+           maskBench.hpp \
+           maskEngine.hpp \
+           maskIndex.hpp \
+           maskJournal.hpp \
+           maskStaging.hpp \
+           maskStorage.hpp \
+           pfmMask.hpp \
            pfmMaskDef.hpp \
            pfmMaskHelp.hpp \
+           rleBitmap.hpp \
            runPage.hpp \
+           srtmCache.hpp \
            startPage.hpp \
            startPageHelp.hpp \
+           swbdCache.hpp \
            version.hpp
-SOURCES += main.cpp pfmMask.cpp runPage.cpp startPage.cpp
+SOURCES += blockCache.cpp landMask.cpp main.cpp maskBatch.cpp maskBench.cpp maskEngine.cpp maskIndex.cpp maskJournal.cpp maskStaging.cpp maskStorage.cpp pfmMask.cpp rleBitmap.cpp runPage.cpp srtmCache.cpp startPage.cpp swbdCache.cpp
 RESOURCES += icons.qrc
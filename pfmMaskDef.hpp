@@ -54,6 +54,30 @@
 #define         NUMHUES             255
 #define         SAMPLE_HEIGHT       200
 #define         SAMPLE_WIDTH        130
+#define         PROGRESS_INTERVAL   250         //  Minimum milliseconds between engine progress signals
+#define         PHASE_ROWS          0           //  Phase progress is in bin rows (rate in bins per second)
+#define         PHASE_CHANGES       1           //  Phase progress is in planned changes (rate in changes per second)
+#define         PHASE_ENTRIES       2           //  Phase progress is in journal entries (rate in entries per second)
+#define         BLOCK_ROWS          16          //  Rows per thread in each block of rows handed to the worker threads
+#define         SRTM_CACHE_SIZE     256         //  Default SRTM topo cache size in megabytes
+#define         SWBD_CACHE_SIZE     64          //  Default SWBD land mask cache size in megabytes
+#define         PLAN_SIZE           16000000    //  Maximum number of planned actions before we apply them
+#define         FILL_BATCH          4096        //  Maximum number of mask records appended before we update their bins
+#define         COMMIT_INTERVAL     60000       //  Milliseconds between progress commits (for --resume)
+
+
+//  Worker thread stages.
+
+#define         MASK_STAGE_CLASSIFY 0
+#define         MASK_STAGE_LAND     1
+
+
+//  Planned actions.
+
+#define         MASK_FILL           0           //  Add a mask record to an empty land bin
+#define         MASK_REMASK         1           //  Replace the value of the mask records in a mask only bin
+#define         MASK_DECON          2           //  Invalidate SRTM data in a bin that also has valid input data
+#define         MASK_REPAIR         3           //  Finish a bin that an interrupted run changed but didn't recompute
 
 
 typedef struct
@@ -72,10 +96,133 @@ typedef struct
 
 
 
+//  Parameters for a single masking run.  These are filled in by the wizard or from the command line in batch mode.
+
+typedef struct
+{
+  QString       pfm_file;                   //  Input PFM list file
+  uint8_t       topo;                       //  Use SRTM topo data instead of the fixed mask value
+  float         mask;                       //  Fixed mask value
+  uint8_t       deconflict;                 //  If SRTM_data is already loaded, deconflict it with the input data
+  uint8_t       verbose;                    //  Print percent complete to stderr (batch mode)
+  int32_t       threads;                    //  Number of worker threads used to classify row stripes
+  int32_t       cache_size;                 //  SRTM topo cache size in megabytes
+  uint8_t       dry_run;                    //  Plan only, open read only (no checkpoint) and don't write anything
+  uint8_t       journal;                    //  Use an undo journal instead of a PFM checkpoint
+  uint8_t       resume;                     //  Pick up an interrupted run from its progress record
+  int32_t       stage_size;                 //  Stage the PFM in memory (megabytes, 0 to work directly on the PFM)
+  int32_t       land_resolution;            //  SWBD mask resolution in arc seconds (0 to match it to the bin size)
+  float         land_fraction;              //  Minimum fraction of a bin that is land to mask it (0 to use the bin center)
+} MASK_PARAMS;
+
+
+//  What the planning pass found.  In a dry run this is what a real run would do.
+
+typedef struct
+{
+  int64_t       inside;                     //  Bins inside the PFM polygon
+  int64_t       land;                       //  Bins inside the polygon that are land (SWBD) or empty land bins (topo)
+  int64_t       fill;                       //  Empty land bins that get a mask record
+  int64_t       remask;                     //  Bins with previous mask records that get re-masked
+  int64_t       decon;                      //  Bins with SRTM and normal data that get deconflicted
+  int64_t       decon_records;              //  SRTM depth records that get invalidated
+  int64_t       repair;                     //  Bins left half done by an interrupted run that get recomputed (--resume)
+} MASK_SUMMARY;
+
+
+//  Counters and cumulative timers (in seconds) for a run.  These go in the JSON run report.
+
+typedef struct
+{
+  int64_t       bins_visited;               //  Bins tested against the PFM polygon
+  int64_t       bins_inside;                //  Bins inside the PFM polygon
+  int64_t       bin_row_reads;              //  read_bin_row calls
+  int64_t       bins_read;                  //  Bin records read by read_bin_row
+  int64_t       bin_record_reads;           //  read_bin_record_index calls
+  int64_t       bin_record_writes;          //  write_bin_record_index calls
+  int64_t       depth_reads;                //  read_depth_array_index calls
+  int64_t       depth_records_read;         //  Depth records read by read_depth_array_index
+  int64_t       swbd_lookups;               //  SWBD land mask lookups (cache hits and misses)
+  int64_t       swbd_hits;
+  int64_t       srtm_lookups;               //  SRTM topo lookups (cache hits and misses)
+  int64_t       srtm_hits;
+  int64_t       records_added;
+  int64_t       records_changed;
+  int64_t       records_invalidated;
+  int64_t       recomputes;                 //  recompute_bin_values_index calls
+  double        open_time;                  //  Open (and checkpoint) the PFM and scan the list files
+  double        land_mask_time;             //  Rasterize the SWBD mask
+  double        classify_time;              //  Polygon classification
+  double        bin_read_time;              //  read_bin_row
+  double        land_value_time;            //  SWBD bits and SRTM lookups for the bins that need them
+  double        plan_time;                  //  Planning (including depth array reads)
+  double        depth_read_time;            //  read_depth_array_index (planning and applying)
+  double        apply_time;                 //  Applying the plan (not including the recompute)
+  double        recompute_time;             //  Recomputing dirty bins
+  double        close_time;                 //  Writing the index and closing the PFM
+  double        total_time;
+} MASK_STATS;
+
+
+
+//  Progress record for an interrupted run (PFM_FILE.mask_progress).  Everything before row has been planned and applied.  The
+//  mode, the land mask settings, and the list file numbers are saved since the options or the list files may have changed since
+//  the run was started.
+
+#define         PROGRESS_MAGIC      "pfmMask resume"
+#define         PROGRESS_VERSION    2
+
+typedef struct
+{
+  char          magic[16];
+  int32_t       version;
+  int32_t       row;                        //  First row that hasn't been committed
+  float         mask;
+  int32_t       topo;
+  int32_t       deconflict;
+  int32_t       decon;
+  int32_t       mask_file;
+  int32_t       file_count;
+  int32_t       line_count;
+  int32_t       add_file;
+  int32_t       land_resolution;            //  SWBD resolution that was used (arc seconds)
+  float         land_fraction;
+  int32_t       journal;
+} MASK_PROGRESS;
+
+
+
+//  Per bin classification results for a block of rows.
+
+typedef struct
+{
+  NV_I32_COORD2 coord;                      //  Bin index
+  uint32_t      validity;                   //  Bin validity (read in the main engine thread)
+  float         avg;                        //  Bin average surface value (for the undo journal)
+  float         value;                      //  Land mask value (0.0 if not land)
+  uint8_t       inside;                     //  Bin center is inside the PFM polygon
+  uint8_t       need;                       //  We need a land value for this bin
+} MASK_CELL;
+
+
+
+//  One entry in the masking plan.
+
+typedef struct
+{
+  NV_I32_COORD2 coord;                      //  Bin index
+  float         value;                      //  New mask value (MASK_FILL and MASK_REMASK, MASK_REPAIR if mask only)
+  float         avg;                        //  Bin average surface value before we change it
+  uint8_t       action;                     //  MASK_FILL, MASK_REMASK, MASK_DECON, or MASK_REPAIR
+} MASK_ACTION;
+
+
+
 typedef struct
 {
   QGroupBox           *mbox;
   QProgressBar        *mbar;
+  QLabel              *mrate;
 } RUN_PROGRESS;
 
 
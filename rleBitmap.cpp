@@ -0,0 +1,186 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#include "rleBitmap.hpp"
+
+
+//  Open a bitmap file and read its header.  Returns NULL if the file doesn't exist or is too short.  The caller checks the
+//  header, reads the rows with readRows, and closes the file.
+
+FILE *
+rleBitmap::open (QString name, void *header, int32_t header_size)
+{
+  FILE *fp;
+
+
+  if ((fp = fopen (name.toLatin1 (), "rb")) == NULL) return (NULL);
+
+  if (fread (header, header_size, 1, fp) != 1)
+    {
+      fclose (fp);
+      return (NULL);
+    }
+
+  return (fp);
+}
+
+
+
+//  Read the rows of a bitmap into bits (which must be cleared).  count is the number of set bits that the header says the
+//  file has.  If the file is truncated or the count doesn't match we can't trust it so we clear bits and return NVFalse.
+
+uint8_t 
+rleBitmap::readRows (FILE *fp, uint8_t *bits, int32_t width, int32_t height, int64_t count)
+{
+  int32_t row_bytes = (width + 7) / 8;
+  int64_t total = 0;
+
+
+  for (int32_t i = 0 ; i < height ; i++)
+    {
+      int32_t runs, run[2];
+
+      if (fread (&runs, sizeof (int32_t), 1, fp) != 1) break;
+
+      uint8_t *dst = &bits[(int64_t) i * row_bytes];
+
+      for (int32_t k = 0 ; k < runs ; k++)
+        {
+          if (fread (run, sizeof (int32_t), 2, fp) != 2 || run[0] < 0 || run[1] < 0 || run[0] + run[1] > width)
+            {
+              runs = -1;
+              break;
+            }
+
+          for (int32_t j = run[0] ; j < run[0] + run[1] ; j++) dst[j >> 3] |= (1 << (j & 7));
+
+          total += run[1];
+        }
+
+      if (runs < 0) break;
+    }
+
+
+  if (total != count)
+    {
+      memset (bits, 0, (int64_t) row_bytes * height);
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+}
+
+
+
+//  Count the set bits in a bitmap (for the header).
+
+int64_t 
+rleBitmap::count (uint8_t *bits, int32_t width, int32_t height)
+{
+  int32_t row_bytes = (width + 7) / 8;
+  int64_t total = 0;
+
+
+  for (int32_t i = 0 ; i < height ; i++)
+    {
+      for (int32_t j = 0 ; j < width ; j++) if (isSet (bits, row_bytes, i, j)) total++;
+    }
+
+  return (total);
+}
+
+
+
+//  Write a bitmap file (the header and the run length encoded rows).  We write to a temporary file and rename it.  On Windows
+//  rename won't replace an existing file so we have to remove the old one first.
+
+uint8_t 
+rleBitmap::write (QString name, void *header, int32_t header_size, uint8_t *bits, int32_t width, int32_t height)
+{
+  FILE *fp;
+
+
+  int32_t row_bytes = (width + 7) / 8;
+
+  QString tmp_name = name + ".tmp";
+
+  if ((fp = fopen (tmp_name.toLatin1 (), "wb")) == NULL) return (NVFalse);
+
+
+  uint8_t ok = (fwrite (header, header_size, 1, fp) == 1);
+
+
+  QVector<int32_t> runs;
+
+  for (int32_t i = 0 ; i < height && ok ; i++)
+    {
+      runs.clear ();
+
+      for (int32_t j = 0 ; j < width ; j++)
+        {
+          if (isSet (bits, row_bytes, i, j))
+            {
+              int32_t start = j;
+
+              while (j < width && isSet (bits, row_bytes, i, j)) j++;
+
+              runs.append (start);
+              runs.append (j - start);
+            }
+        }
+
+      int32_t count = runs.size () / 2;
+
+      if (fwrite (&count, sizeof (int32_t), 1, fp) != 1) ok = NVFalse;
+      if (count && (int32_t) fwrite (runs.data (), sizeof (int32_t), runs.size (), fp) != runs.size ()) ok = NVFalse;
+    }
+
+
+  if (fclose (fp)) ok = NVFalse;
+
+#ifdef NVWIN3X
+  if (ok) remove (name.toLatin1 ());
+#endif
+
+  if (!ok || rename (tmp_name.toLatin1 (), name.toLatin1 ()))
+    {
+      remove (tmp_name.toLatin1 ());
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+}
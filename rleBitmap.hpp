@@ -0,0 +1,69 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#ifndef RLEBITMAP_H
+#define RLEBITMAP_H
+
+#include "pfmMaskDef.hpp"
+
+
+/*!
+    Run length encoded bitmap files for the bin grid sidecars (the mask index and the land mask cache).  The file is a
+    caller defined header followed by each row of the bitmap as a run count and (start column, length) pairs.  The bitmap
+    is one bit per bin with each row padded to a byte boundary.  The header is written to a temporary file that is renamed
+    when everything has been written so that a failed write never leaves a bad file.
+*/
+
+class rleBitmap
+{
+public:
+
+  static FILE *open (QString name, void *header, int32_t header_size);
+  static uint8_t readRows (FILE *fp, uint8_t *bits, int32_t width, int32_t height, int64_t count);
+  static uint8_t write (QString name, void *header, int32_t header_size, uint8_t *bits, int32_t width, int32_t height);
+  static int64_t count (uint8_t *bits, int32_t width, int32_t height);
+
+
+  //  Test the bit for a bin.
+
+  static inline uint8_t isSet (uint8_t *bits, int32_t row_bytes, int32_t row, int32_t col)
+  {
+    return ((bits[(int64_t) row * row_bytes + (col >> 3)] >> (col & 7)) & 1);
+  }
+};
+
+#endif
@@ -42,6 +42,7 @@ runPage::runPage (QWidget *parent, RUN_PROGRESS *prog, QListWidget **cList):
   QWizardPage (parent)
 {
   progress = prog;
+  units = PHASE_ROWS;
 
 
   setTitle (tr ("Process Page"));
@@ -66,6 +67,10 @@ runPage::runPage (QWidget *parent, RUN_PROGRESS *prog, QListWidget **cList):
   mboxLayout->addWidget (progress->mbar);
 
 
+  progress->mrate = new QLabel (" ", this);
+  mboxLayout->addWidget (progress->mrate);
+
+
   vbox->addWidget (progress->mbox);
 
 
@@ -92,3 +97,46 @@ runPage::runPage (QWidget *parent, RUN_PROGRESS *prog, QListWidget **cList):
 
   registerField ("progress_mbar*", progress->mbar, "value");
 }
+
+
+
+//  These are connected (queued) to the masking engine's signals.  The engine runs in its own thread and throttles these
+//  so that we don't spend all of our time updating the GUI.
+
+void 
+runPage::slotPhase (QString title, int range, int phase_units)
+{
+  units = phase_units;
+
+  progress->mbox->setTitle (title);
+  progress->mbar->setRange (0, range);
+  progress->mrate->setText (" ");
+}
+
+
+
+void 
+runPage::slotProgress (int count, double rate)
+{
+  progress->mbar->setValue (count);
+
+
+  //  The count is bin rows while masking, building the land mask, and recomputing but it's plan entries while applying the
+  //  changes and journal entries while rolling back.
+
+  switch (units)
+    {
+    case PHASE_CHANGES:
+      progress->mrate->setText (tr ("%1 of %2 changes, %3 changes/sec").arg (count).arg (progress->mbar->maximum ()).arg (rate, 0, 'f', 0));
+      break;
+
+    case PHASE_ENTRIES:
+      progress->mrate->setText (tr ("%1 of %2 journal entries, %3 entries/sec").arg (count).arg (progress->mbar->maximum ())
+                                .arg (rate, 0, 'f', 0));
+      break;
+
+    default:
+      progress->mrate->setText (tr ("%1 of %2 rows, %3 bins/sec").arg (count).arg (progress->mbar->maximum ()).arg (rate, 0, 'f', 0));
+      break;
+    }
+}
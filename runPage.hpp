@@ -39,7 +39,7 @@
 #ifndef RUNPAGE_H
 #define RUNPAGE_H
 
-#include "pfmMask.hpp"
+#include "pfmMaskDef.hpp"
 
 
 class runPage:public QWizardPage
@@ -61,6 +61,14 @@ protected:
 
   QListWidget      *checkList;
 
+  int32_t          units;                   //  What the engine's progress counts (PHASE_ROWS, PHASE_CHANGES, or PHASE_ENTRIES)
+
+
+public slots:
+
+  void slotPhase (QString title, int range, int phase_units);
+  void slotProgress (int count, double rate);
+
 
 protected slots:
 
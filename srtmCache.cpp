@@ -0,0 +1,112 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#include "srtmCache.hpp"
+
+
+srtmCache::srtmCache (int32_t megabytes)
+  : blockCache (megabytes, sizeof (int16_t))
+{
+}
+
+
+
+//  Set up the SRTM reader and check that the topo data is there.  The reader isn't thread safe so, like readCell, this is done
+//  with the mutex locked.  Just to keep life simple I'm excluding the srtm2 data (DOD restricted).  Since we only use this for
+//  large scale areas it shouldn't matter.
+
+uint8_t 
+srtmCache::init ()
+{
+  QMutexLocker lock (&mutex);
+
+  set_exclude_srtm2_data (NVTrue);
+
+  return (check_srtm3_topo ());
+}
+
+
+
+//  Read a cell from the SRTM topo files.  This is only called with the mutex locked.
+
+int16_t 
+srtmCache::readCell (double lat, double lon)
+{
+  return (read_srtm_topo (lat, lon));
+}
+
+
+
+//  Mark all of the cells in a new block as unread.
+
+void 
+srtmCache::clearBlock (CACHE_BLOCK *block)
+{
+  int16_t *elev = (int16_t *) block->data;
+
+  for (int32_t i = 0 ; i < CACHE_BLOCK_SIZE * CACHE_BLOCK_SIZE ; i++) elev[i] = SRTM_UNREAD;
+}
+
+
+
+//  Return the SRTM elevation for a position, reading it from the SRTM files only if we haven't seen its cell yet.  If hit isn't
+//  NULL it's set to whether the cell was already in the cache.  The cache is shared so the callers keep their own counts.
+
+int16_t 
+srtmCache::elevation (double lat, double lon, uint8_t *hit)
+{
+  QMutexLocker lock (&mutex);
+
+
+  int64_t cy = (int64_t) floor (lat * (double) SRTM_CELLS_PER_DEGREE);
+  int64_t cx = (int64_t) floor (lon * (double) SRTM_CELLS_PER_DEGREE);
+
+  int64_t by = blockIndex (cy);
+  int64_t bx = blockIndex (cx);
+
+  CACHE_BLOCK *block = getBlock ((by + 65536) * 131072 + (bx + 65536));
+
+
+  int16_t *elev = &((int16_t *) block->data)[(cy - by * CACHE_BLOCK_SIZE) * CACHE_BLOCK_SIZE + (cx - bx * CACHE_BLOCK_SIZE)];
+
+  if (hit) *hit = (*elev != SRTM_UNREAD);
+
+  if (*elev == SRTM_UNREAD) *elev = readCell (lat, lon);
+
+  return (*elev);
+}
@@ -0,0 +1,72 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+
+#ifndef SRTMCACHE_H
+#define SRTMCACHE_H
+
+#include "blockCache.hpp"
+
+
+#define         SRTM_CELLS_PER_DEGREE   7200        //  Cache cells per degree (0.5 arc seconds)
+#define         SRTM_UNREAD             -32768      //  Cache cell that hasn't been read yet
+
+
+/*!
+    In memory cache of SRTM topo elevations with least recently used eviction.  The cache is made up of blocks of
+    0.5 arc second cells.  Since every SRTM resolution is aligned to half arc seconds, every position in a cell gets
+    the same value from read_srtm_topo so we only have to read each cell once.  Cells are filled lazily.  The cache
+    is thread safe (and so is the SRTM reader as long as it's only called from here).
+*/
+
+class srtmCache : public blockCache
+{
+public:
+
+  srtmCache (int32_t megabytes = SRTM_CACHE_SIZE);
+
+  virtual uint8_t init ();
+  int16_t elevation (double lat, double lon, uint8_t *hit = NULL);
+
+
+protected:
+
+  void clearBlock (CACHE_BLOCK *block);
+  virtual int16_t readCell (double lat, double lon);
+};
+
+#endif
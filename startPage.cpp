@@ -53,8 +53,9 @@ startPage::startPage (int32_t *argc, char **argv, OPTIONS *op, QWidget *parent):
   setWhatsThis (tr ("See, it really works!"));
 
   QLabel *label = new QLabel (tr ("pfmMask is a tool for masking land areas in a PFM file using the SWBD "
-                                  "1 second land mask.  Help is available by clicking on the Help button and then "
-                                  "clicking on the item for which you want help.  Select a PFM file below.  "
+                                  "land mask (at a resolution matched to the PFM bin size).  Help is available by "
+                                  "clicking on the Help button and then clicking on the item for which you want help.  "
+                                  "Select a PFM file below.  "
                                   "Click <b>Next</b> to continue or <b>Cancel</b> to exit."));
   label->setWordWrap (true);
 
@@ -55,4 +55,5 @@ QString topoText =
 
 QString maskText = 
   startPage::tr ("You may enter the mask value to be stored in PFM cells that have no original input data and "
-                 "are marked as land in the 1 second SWBD.");
+                 "are marked as land in the SWBD.  The coarsest SWBD land mask (1, 3, 30, or 60 seconds) whose cells aren't "
+                 "bigger than the PFM bins is used.");
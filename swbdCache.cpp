@@ -0,0 +1,167 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#include "swbdCache.hpp"
+
+
+//  SWBD mask resolutions in arc seconds, finest first.
+
+static int32_t swbd_resolution[SWBD_RESOLUTIONS] = {1, 3, 30, 60};
+
+
+swbdCache::swbdCache (int32_t megabytes)
+  : blockCache (megabytes, sizeof (uint8_t))
+{
+}
+
+
+
+//  Check to see if the SWBD mask files are available at a resolution (in arc seconds).  The SWBD code isn't thread safe so
+//  this is done with the mutex locked.
+
+uint8_t 
+swbdCache::available (int32_t resolution, QString *reason)
+{
+  QMutexLocker lock (&mutex);
+
+  char *error = check_swbd_mask (resolution);
+
+  if (error != NULL)
+    {
+      *reason = QString (error);
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+}
+
+
+
+//  Something that changes when the SWBD data changes (for the land mask sidecar cache).  nvutility doesn't give us a data
+//  version so we use the names, sizes, and modification times of the mask files for the resolution that we're using
+//  (ABE_DATA/land_mask/swbd_mask_RR_second.*).  Nothing else in the land_mask directory matters.
+
+QString 
+swbdCache::version (int32_t resolution)
+{
+  QDir dir (QString (getenv ("ABE_DATA")) + "/land_mask");
+
+  QString prefix = QString ("swbd_mask_%1_second").arg (resolution, 2, 10, QChar ('0'));
+
+  QFileInfoList files = dir.entryInfoList (QStringList (prefix + ".*"), QDir::Files, QDir::Name);
+
+
+  QString source = QString ("SWBD %1").arg (resolution);
+
+  for (int32_t i = 0 ; i < files.size () ; i++)
+    {
+      source += QString (" %1 %2 %3").arg (files[i].fileName ()).arg ((qlonglong) files[i].size ())
+        .arg ((qlonglong) files[i].lastModified ().toTime_t ());
+    }
+
+  return (source);
+}
+
+
+
+//  Pick the SWBD mask resolution for a bin size (in arc seconds).  Since we only sample the bin centers there's no point in
+//  reading a mask that's much finer than the bins so we use the coarsest mask whose cells are no bigger than a bin.  If that
+//  one isn't installed we try the finer ones.  Returns 0 (with the reason from the 1 second mask) if none are available.
+
+int32_t 
+swbdCache::matchResolution (double bin_seconds, QString *reason)
+{
+  for (int32_t i = SWBD_RESOLUTIONS - 1 ; i >= 0 ; i--)
+    {
+      if (i && (double) swbd_resolution[i] > bin_seconds) continue;
+
+      if (available (swbd_resolution[i], reason)) return (swbd_resolution[i]);
+    }
+
+  return (0);
+}
+
+
+
+//  Read a cell from the SWBD mask.  This is only called with the mutex locked.
+
+uint8_t 
+swbdCache::readCell (double lat, double lon, int32_t resolution)
+{
+  return (swbd_is_land (lat, lon, resolution));
+}
+
+
+
+//  Mark all of the cells in a new block as unread.
+
+void 
+swbdCache::clearBlock (CACHE_BLOCK *block)
+{
+  memset (block->data, SWBD_UNREAD, CACHE_BLOCK_SIZE * CACHE_BLOCK_SIZE);
+}
+
+
+
+//  Return whether a position is land in the SWBD mask of the given resolution (in arc seconds), reading it from the SWBD files
+//  only if we haven't seen its cell yet.  If hit isn't NULL it's set to whether the cell was already in the cache.
+
+uint8_t 
+swbdCache::isLand (double lat, double lon, int32_t resolution, uint8_t *hit)
+{
+  QMutexLocker lock (&mutex);
+
+
+  double cells_per_degree = 3600.0 / (double) resolution;
+
+  int64_t cy = (int64_t) floor (lat * cells_per_degree);
+  int64_t cx = (int64_t) floor (lon * cells_per_degree);
+
+  int64_t by = blockIndex (cy);
+  int64_t bx = blockIndex (cx);
+
+  CACHE_BLOCK *block = getBlock (((int64_t) resolution << 40) + (by + 65536) * 131072 + (bx + 65536));
+
+
+  uint8_t *cell = &block->data[(cy - by * CACHE_BLOCK_SIZE) * CACHE_BLOCK_SIZE + (cx - bx * CACHE_BLOCK_SIZE)];
+
+  if (hit) *hit = (*cell != SWBD_UNREAD);
+
+  if (*cell == SWBD_UNREAD) *cell = readCell (lat, lon, resolution) ? SWBD_LAND : SWBD_WATER;
+
+  return (*cell == SWBD_LAND);
+}
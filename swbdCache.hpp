@@ -0,0 +1,75 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+*********************************************************************************************/
+
+
+/****************************************  IMPORTANT NOTE  **********************************
+
+    Comments in this file that start with / * ! or / / ! are being used by Doxygen to
+    document the software.  Dashes in these comment blocks are used to create bullet lists.
+    The lack of blank lines after a block of dash preceeded comments means that the next
+    block of dash preceeded comments is a new, indented bullet list.  I've tried to keep the
+    Doxygen formatting to a minimum but there are some other items (like <br> and <pre>)
+    that need to be left alone.  If you see a comment that starts with / * ! or / / ! and
+    there is something that looks a bit weird it is probably due to some arcane Doxygen
+    syntax.  Be very careful modifying blocks of Doxygen comments.
+
+*****************************************  IMPORTANT NOTE  **********************************/
+
+
+#ifndef SWBDCACHE_H
+#define SWBDCACHE_H
+
+#include "blockCache.hpp"
+
+
+#define         SWBD_UNREAD         0           //  Cache cell that hasn't been read yet
+#define         SWBD_WATER          1
+#define         SWBD_LAND           2
+#define         SWBD_RESOLUTIONS    4           //  Number of SWBD mask resolutions (see swbd_resolution in swbdCache.cpp)
+
+
+/*!
+    In memory cache of SWBD land/water cells with least recently used eviction.  This works the same way as the SRTM cache.
+    The cache is made up of blocks of SWBD cells (at the requested mask resolution) that are filled lazily.  The cache is
+    thread safe and, since the SWBD reader isn't, all SWBD reads should go through a single cache.  In batch mode one cache
+    is shared by all of the masking engines so adjacent PFMs don't read the same cells again.
+*/
+
+class swbdCache : public blockCache
+{
+public:
+
+  swbdCache (int32_t megabytes = SWBD_CACHE_SIZE);
+
+  virtual uint8_t available (int32_t resolution, QString *reason);
+  int32_t matchResolution (double bin_seconds, QString *reason);
+  virtual QString version (int32_t resolution);
+  uint8_t isLand (double lat, double lon, int32_t resolution, uint8_t *hit = NULL);
+
+
+protected:
+
+  void clearBlock (CACHE_BLOCK *block);
+  virtual uint8_t readCell (double lat, double lon, int32_t resolution);
+};
+
+#endif
@@ -39,7 +39,7 @@
 
 #ifndef VERSION
 
-#define     VERSION     "PFM Software - pfmMask V1.13 - 05/24/19"
+#define     VERSION     "PFM Software - pfmMask V2.00 - 10/17/26"
 
 #endif
 
@@ -149,4 +149,83 @@
 
     - Now uses PFM_USER_10 (PFMv7) instead of PFM_USER_05 (as if anybody is using this program ;-)
 
+
+    Version 2.00
+    PFM Software
+    10/17/26
+
+    - Moved all of the masking code out of the wizard into a separate masking engine (maskEngine).  The wizard
+      is now just a front end to the engine.
+    - Added --batch mode so that PFM files can be masked without a display (e.g. on compute nodes).
+    - The wizard now runs the engine in a separate thread.  Progress (rows done and bins/sec) is sent to the
+      run page a few times a second instead of pumping the GUI event loop for every bin.
+    - Rows are now processed in blocks.  The polygon tests and land lookups for a block are split into row stripes
+      and done by a pool of worker threads (--threads).  All PFM reads and writes are still done, in row order, by
+      the engine thread since the PFM library is not thread safe.
+    - The SWBD land mask is now rasterized onto the PFM bin grid (one bit per bin) in a single pass before masking.
+      The SWBD reader is only called when a bin center moves into a new SWBD cell.
+    - Added an in memory SRTM topo cache (LRU, size set with --cache) so that each SRTM cell is only read once no matter
+      how many bins fall in it.
+    - Added an all water/all land/mixed block pyramid built from the land mask.  When filling empty bins from the
+      SWBD mask, all water blocks are skipped without reading the bins and all land blocks are filled without
+      testing each bin.
+    - Compute the interior spans of the PFM polygon for each row instead of calling bin_inside_ptr for every bin.
+      Bins within one bin of a polygon edge are still checked with bin_inside_ptr so the results are identical.
+    - Split masking into a planning pass and an apply pass.  The planning pass reads the bin records a row at a time
+      (read_bin_row) and the depth arrays it needs, and builds a compact plan of the bins to fill, re-mask, or
+      deconflict.  The apply pass then does all of the writes in bin order.
+    - Mask records for runs of empty land bins are appended in batches (in bin order) before any of the bins are
+      updated so that we aren't bouncing between the depth and bin files for every record.
+    - Bin records are no longer recomputed every time one of their depth records changes.  Changed bins are marked
+      in a dirty bin bitmap and recomputed once each, in bin order, after the plan has been applied.
+    - Filled and re-masked bins in PFMs with MISP or GMT average surfaces are now recomputed, given the mask value as the
+      average surface in memory, and written once.  No more re-reading the bin record after adding the mask point.
+      With --bench-misp, --verify runs the fresh mask and re-mask paths the old way too and checks that the bin records
+      are byte for byte the same.
+    - Added --dry-run to batch mode.  The file is opened without a checkpoint, the planning pass is run, and a report of
+      the bins inside the polygon, land bins, bins to be masked, re-masked, or deconflicted, and the estimated writes is
+      printed.  Nothing is written to the PFM.
+    - Masking runs now write an index of the bins that contain mask records (PFM_FILE.mask_index).  When re-masking a
+      file that has already been masked, only the depth arrays of the indexed bins are read instead of every populated
+      bin in the PFM.
+    - Added --journal to batch mode.  Instead of checkpointing the whole PFM, the before images of the records that are
+      changed are appended to an undo journal (PFM_FILE.mask_journal) that is synced before each block of changes is
+      applied.  --rollback undoes all of the journaled runs.
+    - Runs now commit their progress (PFM_FILE.mask_progress) about once a minute after applying the plan for the rows
+      done so far.  Added --resume to batch mode to pick up an interrupted run at the last committed row.
+    - Batch mode now takes any number of PFM files (and --list files of names or wildcards) and masks them --jobs at a
+      time.  All of the jobs share one SRTM topo cache and one SWBD land mask cache (new), and take turns in the PFM
+      library.  A per file summary is printed at the end.
+    - All PFM reads and writes in the masking engine now go through a storage interface (maskStorage).  The normal
+      backend (pfmStorage) just calls the PFM library.
+    - Added --benchmark.  The masking engine is timed (wall time and bins/sec) on the fresh mask, re-mask, and
+      deconfliction paths using a synthetic in memory PFM with stand-ins for the SWBD and SRTM data.  The grid size, land
+      fraction, polygon shape, points per bin, and MISP surface are set with the --bench-* options.
+    - Every run now writes a JSON run report (PFM_FILE.mask_report.json) with the time spent in each phase (open,
+      land mask, classification, bin reads, land values, planning, depth array reads, apply, recompute, close), and
+      counters for bins visited, bin and depth array I/O, SWBD/SRTM cache hit rates, and records added, changed,
+      invalidated, and recomputed.
+    - Added --stage to batch mode.  The bin grid is read into memory, the depth arrays are read as they're needed, and all
+      of the engine's changes are made in memory and written back to the PFM in one pass (depth changes in file order,
+      new records and bin recomputes in bin order) at each progress commit and at the end of the run.  If the bin grid
+      won't fit in the requested memory the run works directly on the PFM as before.
+    - The bin file is now opened read only alongside the PFM library so that we can tell the kernel that it's read in
+      order and ask it to start reading the next block of bin rows into the page cache while the current block is being
+      classified and planned.
+    - Depth arrays are now read through one engine owned buffer instead of the engine freeing each array itself.  With
+      --stage (and in the benchmark) the buffer grows as needed and is reused for every bin.  Working directly on the
+      PFM, the PFM library still allocates a new array for every read, so that's still one malloc and one free per bin
+      (the buffer just holds the library's array until the next read).
+    - Deconfliction now invalidates all of the SRTM records in a bin with one bulk update call through the storage
+      interface and prints one error report per bin (with the number of records that failed) instead of one per record.
+    - The SWBD land mask resolution is now matched to the bin size.  We use the coarsest mask (1, 3, 30, or 60 seconds)
+      whose cells aren't bigger than a bin, falling back to finer masks if it isn't installed.  It can be set with
+      --land-res in batch mode.
+    - Added --land-fraction to batch mode.  Instead of testing the bin center, a bin is land if at least that fraction of
+      the SWBD cells in it are land.  The land cell counts come from a summed area table of the SWBD cells covering the
+      PFM, built a row at a time, so each bin is a four corner lookup.
+    - The rasterized land mask is now saved next to the PFM (PFM_FILE.mask_land), run length encoded by row, keyed by
+      the grid geometry, a hash of the polygon, the SWBD resolution and land fraction, and the SWBD data location and
+      date.  Later runs on a matching grid read it instead of going back to the SWBD data.
+
 </pre>*/